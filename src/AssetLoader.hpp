@@ -0,0 +1,139 @@
+# pragma once
+# include <Siv3D.hpp>
+# include <future>
+
+// sounds are decoded on a worker thread while the title is up, the GPU/audio side objects
+// and anything else that must run on the main thread are made a little at a time each frame
+class AssetLoader
+{
+public:
+    // target stays empty until the loader is ready
+    void addSound(Audio& target, const FilePath& path, bool loop = false)
+    {
+        m_sounds.push_back(SoundRequest{&target, path, loop});
+    }
+    
+    void addMainThreadTask(std::function<void()> task)
+    {
+        m_tasks.push_back(std::move(task));
+    }
+    
+    void start()
+    {
+        Array<FilePath> paths;
+        for(const auto& sound : m_sounds)
+        {
+            paths << sound.path;
+        }
+        
+        m_waves = std::async(std::launch::async, [paths = std::move(paths)]
+        {
+            Array<Wave> waves;
+            for(const auto& path : paths)
+            {
+                waves << Wave(path);
+            }
+            return waves;
+        });
+    }
+    
+    // call once per frame, main thread tasks run until budgetMs is used up but at least one runs
+    void update(double budgetMs)
+    {
+        if(isReady())
+        {
+            return;
+        }
+        
+        const auto start = std::chrono::steady_clock::now();
+        const auto elapsed = [&]{ return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+        
+        while(m_nextTask < m_tasks.size())
+        {
+            m_tasks[m_nextTask++]();
+            
+            if(budgetMs <= elapsed())
+            {
+                break;
+            }
+        }
+        
+        if(!m_soundsReady && m_waves.valid() && m_waves.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            Array<Wave> waves = m_waves.get();
+            for (auto i : step(m_sounds.size()))
+            {
+                *m_sounds[i].target = m_sounds[i].loop ? Audio(std::move(waves[i]), Arg::loop_<bool>(true)) : Audio(std::move(waves[i]));
+            }
+            m_soundsReady = true;
+        }
+    }
+    
+    bool isReady() const
+    {
+        return m_soundsReady && m_nextTask == m_tasks.size();
+    }
+    
+    // finished work over all work, for a progress bar
+    double progress() const
+    {
+        const size_t total = m_tasks.size() + 1;
+        return static_cast<double>(m_nextTask + (m_soundsReady ? 1 : 0)) / total;
+    }
+    
+private:
+    struct SoundRequest
+    {
+        Audio* target;
+        FilePath path;
+        bool loop;
+    };
+    
+    Array<SoundRequest> m_sounds;
+    Array<std::function<void()>> m_tasks;
+    size_t m_nextTask = 0;
+    std::future<Array<Wave>> m_waves;
+    bool m_soundsReady = false;
+};
+
+// time from entering Main to the first presented frame, and to the point the game accepts a click
+class StartupTimer
+{
+public:
+    StartupTimer()
+    : m_start(std::chrono::steady_clock::now())
+    {}
+    
+    void markFirstFrame()
+    {
+        if(!m_firstFrameMs)
+        {
+            m_firstFrameMs = elapsedMs();
+        }
+    }
+    
+    // logs the report the first time it is called
+    void markInteractive()
+    {
+        if(!m_interactiveMs)
+        {
+            m_interactiveMs = elapsedMs();
+            Logger << report();
+        }
+    }
+    
+    String report() const
+    {
+        return U"first frame : {:.1f} ms  interactive : {:.1f} ms"_fmt(m_firstFrameMs.value_or(0.0), m_interactiveMs.value_or(0.0));
+    }
+    
+private:
+    std::chrono::steady_clock::time_point m_start;
+    Optional<double> m_firstFrameMs;
+    Optional<double> m_interactiveMs;
+    
+    double elapsedMs() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+    }
+};
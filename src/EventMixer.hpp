@@ -0,0 +1,228 @@
+# pragma once
+# include <Siv3D.hpp>
+# include "Simulation.hpp"
+# include "ParticlePool.hpp"
+# include "FrameArena.hpp"
+
+enum class SoundCue : uint8
+{
+    Select,
+    Cancel,
+    PowerUp,
+    Damage,
+    Dead,
+    Count,
+};
+
+// turns a frame's simulation events into at most one start per sound and one burst per spot
+class EventMixer
+{
+public:
+    static constexpr size_t CueCount = static_cast<size_t>(SoundCue::Count);
+    
+    // a cue is not restarted once it has been started this many times within VoiceWindow
+    static constexpr size_t MaxVoices = 4;
+    static constexpr double VoiceWindow = 0.25;
+    
+    // bursts of the same kind closer than this are merged into one
+    static constexpr double MergeCellSize = 40.0;
+    static constexpr int32 MaxMergedCount = 40;
+    
+    // the audio is read at play time, so it may still be loading when it is set
+    void setSound(SoundCue cue, const Audio& audio)
+    {
+        m_cues[static_cast<size_t>(cue)].audio = &audio;
+    }
+    
+    // reads every event since the last clearEvents, call once per frame; the merge tables come from the frame arena
+    void consume(const EventRing<SimEvent>& events, ParticlePool& particles, FrameArena& arena, double dt)
+    {
+        m_time += dt;
+        m_requested.fill(false);
+        
+        BurstTable bursts;
+        bursts.bursts = arena.allocate<Burst>(events.size());
+        bursts.slots = arena.allocate<uint32>(SlotCount(events.size()));
+        
+        for(const auto& event : events)
+        {
+            switch (event.type)
+            {
+                // card clicks of the versus rival are not heard
+                case SimEventType::Select:
+                    if(!event.isEnemy)
+                    {
+                        request(SoundCue::Select);
+                    }
+                    break;
+                case SimEventType::Cancel:
+                    if(!event.isEnemy)
+                    {
+                        request(SoundCue::Cancel);
+                    }
+                    break;
+                case SimEventType::PowerUp:
+                    if(!event.isEnemy)
+                    {
+                        request(SoundCue::PowerUp);
+                    }
+                    break;
+                case SimEventType::Hit:
+                    addBurst(bursts, Emitters::Default, BurstTint::None, event.pos, event.count);
+                    break;
+                case SimEventType::Damage:
+                    request(SoundCue::Damage);
+                    break;
+                case SimEventType::Kill:
+                    addBurst(bursts, Emitters::Fall, event.isEnemy ? BurstTint::Blue : BurstTint::Red, event.pos, event.count);
+                    request(SoundCue::Dead);
+                    break;
+                case SimEventType::Breakthrough:
+                    request(event.isEnemy ? SoundCue::Dead : SoundCue::PowerUp);
+                    break;
+                case SimEventType::Bomb:
+                    request(SoundCue::Dead);
+                    for(const auto& i : step(event.count))
+                    {
+                        particles.emit(Emitters::Default, Vec2(200+i*150,LaneHeight/2-200), 20);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        
+        m_lastEventCount = events.size();
+        
+        m_lastBurstCount = bursts.count;
+        for (size_t i = 0; i < bursts.count; ++i)
+        {
+            const Burst& burst = bursts.bursts[i];
+            particles.emit(*burst.emitter, burst.pos, burst.count, TintColor(burst.tint));
+        }
+        
+        for (auto i : step(CueCount))
+        {
+            if(m_requested[i])
+            {
+                play(m_cues[i]);
+            }
+        }
+    }
+    
+    size_t lastEventCount() const
+    {
+        return m_lastEventCount;
+    }
+    
+    size_t lastBurstCount() const
+    {
+        return m_lastBurstCount;
+    }
+    
+private:
+    enum class BurstTint : uint8
+    {
+        None,
+        Blue,
+        Red,
+    };
+    
+    struct Burst
+    {
+        const ParticleEmitter* emitter;
+        BurstTint tint;
+        Vec2 pos;
+        int32 count;
+        uint64 key;
+    };
+    
+    // open addressing over the bursts, a slot holds a burst index plus one or 0 when empty
+    struct BurstTable
+    {
+        ArenaSpan<Burst> bursts;
+        ArenaSpan<uint32> slots;
+        size_t count = 0;
+    };
+    
+    struct Cue
+    {
+        const Audio* audio = nullptr;
+        std::array<double, MaxVoices> starts = {};
+        size_t next = 0;
+    };
+    
+    std::array<Cue, CueCount> m_cues;
+    std::array<bool, CueCount> m_requested = {};
+    size_t m_lastEventCount = 0;
+    size_t m_lastBurstCount = 0;
+    double m_time = 0.0;
+    
+    static ColorF TintColor(BurstTint tint)
+    {
+        switch (tint)
+        {
+            case BurstTint::Blue:
+                return Palette::Blue;
+            case BurstTint::Red:
+                return Palette::Red;
+            default:
+                return Palette::White;
+        }
+    }
+    
+    void request(SoundCue cue)
+    {
+        m_requested[static_cast<size_t>(cue)] = true;
+    }
+    
+    // the oldest of the last MaxVoices starts must have left the window
+    void play(Cue& cue)
+    {
+        if(!cue.audio || !*cue.audio || (m_time - cue.starts[cue.next] < VoiceWindow && cue.starts[cue.next] != 0.0))
+        {
+            return;
+        }
+        
+        cue.audio->playOneShot();
+        cue.starts[cue.next] = m_time;
+        cue.next = (cue.next+1) % MaxVoices;
+    }
+    
+    // a power of two at least twice the number of events, so probing always finds a free slot
+    static size_t SlotCount(size_t events)
+    {
+        size_t n = 16;
+        while(n < events*2)
+        {
+            n *= 2;
+        }
+        return n;
+    }
+    
+    void addBurst(BurstTable& table, const ParticleEmitter& emitter, BurstTint tint, const Vec2& pos, int32 count)
+    {
+        const uint64 cellX = static_cast<uint32>(static_cast<int32>(Floor(pos.x / MergeCellSize)));
+        const uint64 cellY = static_cast<uint16>(static_cast<int32>(Floor(pos.y / MergeCellSize)));
+        const uint64 kind = (&emitter == &Emitters::Fall ? 4 : 0) | static_cast<uint64>(tint);
+        const uint64 key = (kind << 48) | (cellY << 32) | cellX;
+        
+        const size_t mask = table.slots.size() - 1;
+        for (size_t slot = (key * 0x9E3779B97F4A7C15ull >> 32) & mask;; slot = (slot+1) & mask)
+        {
+            if(table.slots[slot] == 0)
+            {
+                table.bursts[table.count] = Burst{&emitter, tint, pos, count, key};
+                table.slots[slot] = static_cast<uint32>(++table.count);
+                return;
+            }
+            
+            Burst& burst = table.bursts[table.slots[slot]-1];
+            if(burst.key == key)
+            {
+                burst.count = Min(burst.count + count, MaxMergedCount);
+                return;
+            }
+        }
+    }
+};
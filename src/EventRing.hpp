@@ -0,0 +1,107 @@
+# pragma once
+# include <Siv3D.hpp>
+
+// fixed-capacity FIFO, once full the oldest entry is overwritten so pushing never allocates
+template <class Type>
+class EventRing
+{
+public:
+    class Iterator
+    {
+    public:
+        Iterator(const EventRing* ring, size_t n)
+        : m_ring(ring)
+        , m_n(n)
+        {}
+        
+        const Type& operator*() const
+        {
+            return (*m_ring)[m_n];
+        }
+        
+        Iterator& operator++()
+        {
+            ++m_n;
+            return *this;
+        }
+        
+        bool operator!=(const Iterator& other) const
+        {
+            return m_n != other.m_n;
+        }
+        
+    private:
+        const EventRing* m_ring;
+        size_t m_n;
+    };
+    
+    explicit EventRing(size_t capacity)
+    : m_items(capacity)
+    {}
+    
+    void push(const Type& item)
+    {
+        const size_t capacity = m_items.size();
+        
+        if(m_count == capacity)
+        {
+            m_first = (m_first+1) % capacity;
+            --m_count;
+            ++m_dropped;
+        }
+        
+        m_items[(m_first+m_count) % capacity] = item;
+        ++m_count;
+    }
+    
+    // n-th oldest entry
+    const Type& operator[](size_t n) const
+    {
+        return m_items[(m_first+n) % m_items.size()];
+    }
+    
+    Iterator begin() const
+    {
+        return Iterator(this, 0);
+    }
+    
+    Iterator end() const
+    {
+        return Iterator(this, m_count);
+    }
+    
+    size_t size() const
+    {
+        return m_count;
+    }
+    
+    bool isEmpty() const
+    {
+        return m_count == 0;
+    }
+    
+    // entries overwritten before anyone read them, since the last clear
+    size_t dropped() const
+    {
+        return m_dropped;
+    }
+    
+    // keeps the count oldest entries and forgets anything pushed after them
+    void truncate(size_t count)
+    {
+        m_count = Min(m_count, count);
+    }
+    
+    void clear()
+    {
+        m_first = 0;
+        m_count = 0;
+        m_dropped = 0;
+    }
+    
+private:
+    Array<Type> m_items;
+    size_t m_first = 0;
+    size_t m_count = 0;
+    size_t m_dropped = 0;
+};
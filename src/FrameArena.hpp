@@ -0,0 +1,195 @@
+# pragma once
+# include <Siv3D.hpp>
+# include <atomic>
+# if SIV3D_PLATFORM(WINDOWS)
+#   include <Siv3D/Windows.hpp>
+#   include <Psapi.h>
+# elif SIV3D_PLATFORM(MACOS)
+#   include <mach/mach.h>
+# else
+#   include <cstdio>
+#   include <unistd.h>
+# endif
+
+// global operator new calls since start-up, the replacement operators are defined in Main.cpp
+namespace HeapStats
+{
+    inline std::atomic<uint64> allocations{0};
+    
+    // the same count for the calling thread only, so workers and the audio thread do not show up in it
+    inline thread_local uint64 threadAllocations = 0;
+    
+    // bytes asked of operator new on the calling thread
+    inline thread_local uint64 threadBytes = 0;
+    
+    inline uint64 Allocations()
+    {
+        return allocations.load(std::memory_order_relaxed);
+    }
+    
+    inline uint64 ThreadAllocations()
+    {
+        return threadAllocations;
+    }
+    
+    inline uint64 ThreadBytes()
+    {
+        return threadBytes;
+    }
+    
+    // the process's resident memory, which also sees what libraries malloc behind operator new; 0 if unknown
+    inline uint64 ResidentBytes()
+    {
+    # if SIV3D_PLATFORM(WINDOWS)
+        PROCESS_MEMORY_COUNTERS counters = {};
+        if(::K32GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return counters.WorkingSetSize;
+        }
+        return 0;
+    # elif SIV3D_PLATFORM(MACOS)
+        mach_task_basic_info info = {};
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if(::task_info(::mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS)
+        {
+            return info.resident_size;
+        }
+        return 0;
+    # else
+        unsigned long long pages = 0, resident = 0;
+        std::FILE* file = std::fopen("/proc/self/statm", "r");
+        if(!file)
+        {
+            return 0;
+        }
+        const bool isRead = (std::fscanf(file, "%llu %llu", &pages, &resident) == 2);
+        std::fclose(file);
+        return isRead ? resident * static_cast<uint64>(::sysconf(_SC_PAGESIZE)) : 0;
+    # endif
+    }
+}
+
+// a run of objects handed out by a FrameArena, valid until the arena is reset
+template <class Type>
+class ArenaSpan
+{
+public:
+    ArenaSpan() = default;
+    
+    ArenaSpan(Type* data, size_t size)
+    : m_data(data)
+    , m_size(size)
+    {}
+    
+    Type& operator[](size_t i) const
+    {
+        return m_data[i];
+    }
+    
+    Type* begin() const
+    {
+        return m_data;
+    }
+    
+    Type* end() const
+    {
+        return m_data + m_size;
+    }
+    
+    size_t size() const
+    {
+        return m_size;
+    }
+    
+    bool isEmpty() const
+    {
+        return m_size == 0;
+    }
+    
+private:
+    Type* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// bump allocator for data that only lives for one frame or tick, everything is released by reset();
+// a request that does not fit goes to an overflow block and the main block is grown at the next reset,
+// so after the first few frames a steady load never touches the heap
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity)
+    : m_block(capacity)
+    {}
+    
+    // value-initialised, nothing is destroyed so only trivially destructible types are allowed
+    template <class Type>
+    ArenaSpan<Type> allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<Type>);
+        
+        if(count == 0)
+        {
+            return ArenaSpan<Type>();
+        }
+        
+        Type* data = static_cast<Type*>(allocateBytes(sizeof(Type) * count, alignof(Type)));
+        for (size_t i = 0; i < count; ++i)
+        {
+            new (data + i) Type();
+        }
+        return ArenaSpan<Type>(data, count);
+    }
+    
+    void reset()
+    {
+        m_highWater = Max(m_highWater, m_used + m_overflowUsed);
+        
+        if(!m_overflow.isEmpty())
+        {
+            m_overflow.clear();
+            m_block.resize(m_highWater * 2);
+        }
+        
+        m_used = 0;
+        m_overflowUsed = 0;
+    }
+    
+    size_t used() const
+    {
+        return m_used + m_overflowUsed;
+    }
+    
+    size_t capacity() const
+    {
+        return m_block.size();
+    }
+    
+    size_t highWater() const
+    {
+        return Max(m_highWater, used());
+    }
+    
+private:
+    Array<uint8> m_block;
+    size_t m_used = 0;
+    Array<Array<uint8>> m_overflow;
+    size_t m_overflowUsed = 0;
+    size_t m_highWater = 0;
+    
+    void* allocateBytes(size_t size, size_t align)
+    {
+        const uintptr_t base = reinterpret_cast<uintptr_t>(m_block.data());
+        const size_t offset = ((base + m_used + align - 1) & ~(align - 1)) - base;
+        
+        if(offset + size <= m_block.size())
+        {
+            m_used = offset + size;
+            return m_block.data() + offset;
+        }
+        
+        m_overflow.emplace_back(size + align);
+        m_overflowUsed += size + align;
+        const uintptr_t overflowBase = reinterpret_cast<uintptr_t>(m_overflow.back().data());
+        return reinterpret_cast<void*>((overflowBase + align - 1) & ~(align - 1));
+    }
+};
@@ -0,0 +1,117 @@
+# pragma once
+# include <Siv3D.hpp>
+# include "RenderBatch.hpp"
+
+// a line of text shaped once and drawn from its glyphs until the value changes
+class CachedText
+{
+public:
+    explicit CachedText(const Font& font)
+    : m_font(font)
+    {}
+    
+    void setNumber(int32 value)
+    {
+        if(m_number && *m_number == value)
+        {
+            return;
+        }
+        
+        m_number = value;
+        reshape(Format(value));
+    }
+    
+    void setText(StringView text)
+    {
+        if(!m_number && m_text == text)
+        {
+            return;
+        }
+        
+        m_number.reset();
+        reshape(String(text));
+    }
+    
+    void draw(RenderBatch& batch, const Vec2& pos, const ColorF& color) const
+    {
+        Vec2 penPos = pos;
+        for(const auto& glyph : m_glyphs)
+        {
+            batch.addTexture(glyph.texture, penPos + glyph.offset, color);
+            penPos.x += glyph.xAdvance;
+        }
+    }
+    
+    void drawTopRight(RenderBatch& batch, const Vec2& pos, const ColorF& color) const
+    {
+        draw(batch, pos - Vec2(m_width, 0), color);
+    }
+    
+    // how many times the text was laid out again, for the debug line
+    size_t reshapes() const
+    {
+        return m_reshapes;
+    }
+    
+private:
+    Font m_font;
+    Optional<int32> m_number;
+    String m_text;
+    Array<Glyph> m_glyphs;
+    double m_width = 0.0;
+    size_t m_reshapes = 0;
+    
+    void reshape(String&& text)
+    {
+        m_text = std::move(text);
+        m_glyphs = m_font.getGlyphs(m_text);
+        
+        m_width = 0.0;
+        for(const auto& glyph : m_glyphs)
+        {
+            m_width += glyph.xAdvance;
+        }
+        ++m_reshapes;
+    }
+};
+
+// the parts of the HUD that only change with a few values are drawn once into a render texture;
+// the texture keeps premultiplied colour so it composites over the lane without dark fringes
+class StaticLayer
+{
+public:
+    explicit StaticLayer(const Size& size)
+    : m_texture(size)
+    {}
+    
+    // drawContent runs into the texture only when key differs from the last call
+    template <class Fty>
+    void draw(uint64 key, Fty&& drawContent)
+    {
+        if(!m_key || *m_key != key)
+        {
+            m_key = key;
+            ++m_rebuilds;
+            
+            m_texture.clear(ColorF(0.0, 0.0));
+            {
+                ScopedRenderTarget2D target(m_texture);
+                ScopedRenderStates2D blend(BlendState(true, Blend::SrcAlpha, Blend::InvSrcAlpha, BlendOp::Add, Blend::One, Blend::InvSrcAlpha, BlendOp::Add));
+                drawContent();
+            }
+        }
+        
+        ScopedRenderStates2D blend(BlendState::Premultiplied);
+        m_texture.draw();
+    }
+    
+    size_t rebuilds() const
+    {
+        return m_rebuilds;
+    }
+    
+private:
+    RenderTexture m_texture;
+    Optional<uint64> m_key;
+    size_t m_rebuilds = 0;
+};
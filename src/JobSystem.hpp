@@ -0,0 +1,217 @@
+# pragma once
+# include <Siv3D.hpp>
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <atomic>
+# include <array>
+# include <deque>
+
+// small work-stealing pool, each worker owns a queue and steals from the others when it runs dry;
+// the queues are fixed rings, so handing out work never touches the heap
+class JobSystem
+{
+public:
+    // jobs one queue holds, a chunk that finds its queue full runs on the calling thread instead
+    static constexpr size_t QueueCapacity = 1024;
+    
+    explicit JobSystem(size_t workerCount = Max<size_t>(std::thread::hardware_concurrency(), 2) - 1)
+    : m_queues(workerCount + 1)
+    {
+        for (size_t i = 0; i < workerCount; ++i)
+        {
+            m_workers.emplace_back([this, i]{ workerLoop(i + 1); });
+        }
+    }
+    
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_quit = true;
+        }
+        m_wake.notify_all();
+        
+        for(auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+    
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    
+    // including the calling thread, which helps out while it waits
+    size_t threadCount() const
+    {
+        return m_queues.size();
+    }
+    
+    // calls body(chunkIndex, begin, end) for every chunk of [0, count) and returns once all are done
+    template <class Fty>
+    void parallelFor(size_t count, size_t chunkSize, Fty&& body)
+    {
+        if(count == 0)
+        {
+            return;
+        }
+        
+        const size_t chunks = (count + chunkSize - 1) / chunkSize;
+        if(chunks == 1 || m_workers.empty())
+        {
+            for (size_t c = 0; c < chunks; ++c)
+            {
+                body(c, c*chunkSize, Min(count, (c+1)*chunkSize));
+            }
+            return;
+        }
+        
+        Task task;
+        task.context = const_cast<void*>(static_cast<const void*>(&body));
+        task.invoke = [](void* context, size_t chunk, size_t begin, size_t end)
+        {
+            (*static_cast<std::remove_reference_t<Fty>*>(context))(chunk, begin, end);
+        };
+        task.remaining = chunks;
+        
+        for (size_t c = 0; c < chunks; ++c)
+        {
+            const Job job{&task, c, c*chunkSize, Min(count, (c+1)*chunkSize)};
+            bool isQueued = false;
+            {
+                Queue& queue = m_queues[c % m_queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                isQueued = queue.pushBack(job);
+            }
+            
+            if(!isQueued)
+            {
+                run(job);
+            }
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            ++m_generation;
+        }
+        m_wake.notify_all();
+        
+        while(task.remaining.load(std::memory_order_acquire) != 0)
+        {
+            if(!runOne(0))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+    
+private:
+    struct Task
+    {
+        void* context = nullptr;
+        void (*invoke)(void*, size_t, size_t, size_t) = nullptr;
+        std::atomic<size_t> remaining{0};
+    };
+    
+    struct Job
+    {
+        Task* task;
+        size_t chunk;
+        size_t begin;
+        size_t end;
+    };
+    
+    // a ring of QueueCapacity jobs, only touched with the mutex held
+    struct Queue
+    {
+        std::mutex mutex;
+        std::array<Job, QueueCapacity> jobs;
+        size_t first = 0;
+        size_t count = 0;
+        
+        bool pushBack(const Job& job)
+        {
+            if(count == QueueCapacity)
+            {
+                return false;
+            }
+            jobs[(first + count) % QueueCapacity] = job;
+            ++count;
+            return true;
+        }
+        
+        Job popBack()
+        {
+            --count;
+            return jobs[(first + count) % QueueCapacity];
+        }
+        
+        Job popFront()
+        {
+            const Job job = jobs[first];
+            first = (first + 1) % QueueCapacity;
+            --count;
+            return job;
+        }
+    };
+    
+    Array<std::thread> m_workers;
+    std::deque<Queue> m_queues;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    uint64 m_generation = 0;
+    bool m_quit = false;
+    
+    // own queue from the back, everyone else's from the front
+    bool runOne(size_t self)
+    {
+        Optional<Job> job;
+        
+        for (size_t n = 0; n < m_queues.size() && !job; ++n)
+        {
+            Queue& queue = m_queues[(self + n) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            
+            if(queue.count == 0)
+            {
+                continue;
+            }
+            
+            job = (n == 0) ? queue.popBack() : queue.popFront();
+        }
+        
+        if(!job)
+        {
+            return false;
+        }
+        
+        run(*job);
+        return true;
+    }
+    
+    static void run(const Job& job)
+    {
+        job.task->invoke(job.task->context, job.chunk, job.begin, job.end);
+        job.task->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    
+    void workerLoop(size_t self)
+    {
+        uint64 seen = 0;
+        
+        for (;;)
+        {
+            while(runOne(self))
+            {
+            }
+            
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait(lock, [&]{ return m_quit || seen != m_generation; });
+            if(m_quit)
+            {
+                return;
+            }
+            seen = m_generation;
+        }
+    }
+};
@@ -0,0 +1,1349 @@
+# pragma once
+# include <Siv3D.hpp>
+# include "Simulation.hpp"
+# include "Netplay.hpp"
+# include "RenderBatch.hpp"
+# include "ParticlePool.hpp"
+# include "EventMixer.hpp"
+# include "FrameArena.hpp"
+# include "SoftwareRaster.hpp"
+
+// how the scripted player clicks the item cards
+enum class AutoPolicy : uint8
+{
+    None,
+    SpamGeki,
+    SaveForSei,
+    Mixed,
+};
+
+struct LoadScenario
+{
+    String name;
+    AutoPolicy policy;
+    double spawnRate;
+    int32 ticks;
+    
+    // fixed fights start with this many units and bullets already on the lane
+    size_t units = 0;
+    size_t bullets = 0;
+    
+    // ticks between bullet collision checks
+    int32 collisionInterval = 1;
+};
+
+struct LoadResult
+{
+    String name;
+    int32 ticks = 0;
+    double seconds = 0.0;
+    size_t peakPlayers = 0;
+    size_t peakEnemies = 0;
+    size_t peakBullets = 0;
+    
+    // mean per tick
+    std::array<double, PhaseProfiler::PhaseCount> phaseMs = {};
+    
+    std::chrono::steady_clock::time_point startedAt;
+    
+    // the timed part of a run is between these two
+    void startClock()
+    {
+        startedAt = std::chrono::steady_clock::now();
+    }
+    
+    void stopClock()
+    {
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startedAt).count();
+    }
+    
+    // the peaks after one more tick
+    void observe(const Simulation& sim)
+    {
+        peakPlayers = Max(peakPlayers, sim.getPlayers().size());
+        peakEnemies = Max(peakEnemies, sim.getEnemies().size());
+        peakBullets = Max(peakBullets, sim.getBullets().count());
+    }
+    
+    double ticksPerSecond() const
+    {
+        return (0.0 < seconds) ? ticks / seconds : 0.0;
+    }
+};
+
+namespace LoadTest
+{
+    constexpr int32 GrowthInterval = 600;
+    
+    // benchmarks whose work has no side effect write a result here
+    inline volatile size_t Sink = 0;
+    
+    inline const Array<LoadScenario> Scenarios =
+    {
+        { U"spam_geki",         AutoPolicy::SpamGeki,   1.0,   TickRate*180 },
+        { U"save_for_sei",      AutoPolicy::SaveForSei, 1.0,   TickRate*180 },
+        { U"mixed",             AutoPolicy::Mixed,      1.0,   TickRate*180 },
+        { U"mixed_rate10",      AutoPolicy::Mixed,      10.0,  TickRate*60 },
+        { U"mixed_rate100",     AutoPolicy::Mixed,      100.0, TickRate*30 },
+        { U"fight_1k",          AutoPolicy::None,       1.0,   300, 1000,   1000 },
+        { U"fight_10k",         AutoPolicy::None,       1.0,   120, 10000,  10000 },
+        { U"fight_100k",        AutoPolicy::None,       1.0,   60,  100000, 100000 },
+        { U"fight_10k_every4",  AutoPolicy::None,       1.0,   120, 10000,  10000,  4 },
+        { U"fight_100k_every4", AutoPolicy::None,       1.0,   60,  100000, 100000, 4 },
+    };
+    
+    // energy the next unit of this kind costs, following the grade tiers in Simulation::buy
+    inline int32 NextCost(const Array<int32>& itemNumber, size_t item)
+    {
+        const int32 number = itemNumber[item];
+        const int32 tier = (number < 10) ? 1 : (number < 25) ? 2 : 3;
+        return UnitArchetypes[item].cost * tier;
+    }
+    
+    // isEnemy clicks for the enemy side of a versus match
+    inline SimInput Decide(AutoPolicy policy, const Simulation& sim, size_t& mixedNext, bool isEnemy = false)
+    {
+        SimInput input;
+        const int32 energy = isEnemy ? sim.getRival().energy : sim.getEnergy();
+        const Array<int32>& itemNumber = isEnemy ? sim.getRival().itemNumber : sim.getItemNumber();
+        
+        switch (policy)
+        {
+            case AutoPolicy::SpamGeki:
+                input.item = static_cast<size_t>(UnitKind::Geki);
+                break;
+            case AutoPolicy::SaveForSei:
+                if(NextCost(itemNumber, static_cast<size_t>(UnitKind::Sei)) < energy)
+                {
+                    input.item = static_cast<size_t>(UnitKind::Sei);
+                }
+                break;
+            case AutoPolicy::Mixed:
+                if(NextCost(itemNumber, mixedNext) < energy)
+                {
+                    input.item = mixedNext;
+                    mixedNext = (mixedNext+1) % UnitArchetypes.size();
+                }
+                break;
+            default:
+                break;
+        }
+        
+        return input;
+    }
+    
+    // both teams spread over their half of the lane, with bullets already in flight
+    inline void SetUpFight(Simulation& sim, const LoadScenario& scenario)
+    {
+        SimRandom random(scenario.units ^ scenario.bullets);
+        const double y = LaneHeight/2+100;
+        
+        for (size_t i = 0; i < scenario.units; ++i)
+        {
+            const bool isEnemy = (i % 2 == 1);
+            const UnitKind kind = static_cast<UnitKind>(i / 2 % UnitArchetypes.size());
+            const double x = isEnemy ? random.range(LaneWidth/2, LaneWidth+50) : random.range(-50, LaneWidth/2);
+            (isEnemy ? sim.getEnemies() : sim.getPlayers()).emplace_back(kind, 1, isEnemy, Vec2(x, y));
+        }
+        
+        for (size_t i = 0; i < scenario.bullets; ++i)
+        {
+            const bool isEnemy = (i % 2 == 1);
+            sim.getBullets().spawn(BulletType::Normal, isEnemy, isEnemy, Vec2(random.range(0, LaneWidth), y), 10.0);
+        }
+    }
+    
+    inline LoadResult Run(const LoadScenario& scenario, JobSystem* jobs, TextWriter& growth)
+    {
+        WaveTable waves = WaveTable::Default();
+        waves.rate = scenario.spawnRate;
+        
+        Simulation sim(1, waves);
+        PhaseProfiler profiler;
+        sim.setProfiler(&profiler);
+        sim.setJobSystem(jobs);
+        sim.setCollisionInterval(scenario.collisionInterval);
+        SetUpFight(sim, scenario);
+        
+        LoadResult result;
+        result.name = scenario.name;
+        size_t mixedNext = 0;
+        
+        result.startClock();
+        auto segmentStart = result.startedAt;
+        
+        for (int32 tick = 1; tick <= scenario.ticks && !sim.isGameOver(); ++tick)
+        {
+            profiler.beginFrame();
+            sim.step(Decide(scenario.policy, sim, mixedNext));
+            sim.clearEvents();
+            profiler.endFrame();
+            
+            for (auto i : step(PhaseProfiler::PhaseCount))
+            {
+                result.phaseMs[i] += profiler.lastTime(static_cast<FramePhase>(i));
+            }
+            
+            result.ticks = tick;
+            result.observe(sim);
+            
+            if(tick % GrowthInterval == 0)
+            {
+                const auto now = std::chrono::steady_clock::now();
+                const double seconds = std::chrono::duration<double>(now - segmentStart).count();
+                growth.writeln(U"{},{},{},{},{},{:.1f},{:.4f},{:.4f}"_fmt(scenario.name, tick, sim.getPlayers().size(), sim.getEnemies().size(), sim.getBullets().count(),
+                    GrowthInterval / seconds, profiler.percentile(FramePhase::Collision, 0.5), profiler.percentile(FramePhase::Update, 0.5)));
+                segmentStart = now;
+            }
+        }
+        
+        result.stopClock();
+        
+        for(auto& ms : result.phaseMs)
+        {
+            ms /= Max(result.ticks, 1);
+        }
+        
+        return result;
+    }
+    
+    struct CollisionCounts
+    {
+        size_t hits = 0;
+        size_t kills = 0;
+        
+        // players, enemies and bullets after the pass
+        uint64 hash = 0;
+        
+        bool operator==(const CollisionCounts& other) const
+        {
+            return hits == other.hits && kills == other.kills && hash == other.hash;
+        }
+    };
+    
+    inline uint64 HashFight(const Array<Player>& players, const Array<Player>& enemies, const BulletStore& bullets)
+    {
+        StateHash hash;
+        for(const auto& unit : players)
+        {
+            unit.hashInto(hash);
+        }
+        for(const auto& unit : enemies)
+        {
+            unit.hashInto(hash);
+        }
+        bullets.hashInto(hash);
+        return hash.value();
+    }
+    
+    // the collision pass the way the original nested loops ran it, O(players * enemies + bullets * units):
+    // every player against every enemy, then every bullet against the whole other team, each pair
+    // tested against the positions of the moment
+    inline CollisionCounts NestedCollide(Array<Player>& players, Array<Player>& enemies, BulletStore& bullets, int32 interval)
+    {
+        CollisionCounts counts;
+        
+        for(auto& player : players)
+        {
+            for(auto& enemy : enemies)
+            {
+                if(player.alive() && enemy.alive() && Circle(player.getPos(),30).intersects(Circle(enemy.getPos(),30)))
+                {
+                    ++counts.hits;
+                    counts.kills += player.nockBack(5*enemy.getGrade());
+                    counts.kills += enemy.nockBack(5*player.getGrade());
+                }
+            }
+        }
+        
+        // a bullet is a circle of 20 and a unit one of 30
+        const int32 from = bullets.now() - interval;
+        for(auto& lane : bullets.getLanes())
+        {
+            for (size_t b = 0; b < lane.size(); ++b)
+            {
+                for(auto& target : lane.isEnemyTeam[b] ? players : enemies)
+                {
+                    if(lane.alive[b] && target.alive() && bullets.sweptHit(lane, b, from, target.getPos(), 20.0 + 30.0))
+                    {
+                        ++counts.hits;
+                        bullets.kill(lane, b);
+                        counts.kills += target.nockBack(2);
+                    }
+                }
+            }
+        }
+        
+        counts.hash = HashFight(players, enemies, bullets);
+        return counts;
+    }
+    
+    struct CollisionResult
+    {
+        LoadResult indexed;
+        LoadResult nested;
+        CollisionCounts indexedCounts;
+        CollisionCounts nestedCounts;
+        
+        // events the simulation had to drop, which would make its counts meaningless
+        size_t dropped = 0;
+        
+        bool isMatching() const
+        {
+            return dropped == 0 && indexedCounts == nestedCounts;
+        }
+    };
+    
+    // one collision pass over a fixed fight, through the simulation and through the nested loops, each
+    // from the same snapshot; the indexed time includes sorting the lane indices from scratch
+    inline CollisionResult RunCollision(size_t units, int32 rounds)
+    {
+        Simulation sim(1), reference(1);
+        sim.setEventCapacity(units*16);
+        SetUpFight(sim, LoadScenario{ U"collide", AutoPolicy::None, 1.0, 0, units, units });
+        
+        Array<uint8> bytes;
+        sim.saveSnapshot(bytes);
+        
+        CollisionResult result;
+        result.indexed.name = U"collide_{}"_fmt(units);
+        result.nested.name = U"collide_nested_{}"_fmt(units);
+        
+        for (int32 round = 0; round < rounds; ++round)
+        {
+            sim.loadSnapshot(bytes);
+            sim.clearEvents();
+            auto start = std::chrono::steady_clock::now();
+            sim.collideOnce();
+            result.indexed.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            
+            reference.loadSnapshot(bytes);
+            start = std::chrono::steady_clock::now();
+            result.nestedCounts = NestedCollide(reference.getPlayers(), reference.getEnemies(), reference.getBullets(), 1);
+            result.nested.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        
+        result.indexedCounts = CollisionCounts();
+        for(const auto& event : sim.getEvents())
+        {
+            result.indexedCounts.hits += (event.type == SimEventType::Hit);
+            result.indexedCounts.kills += (event.type == SimEventType::Kill);
+        }
+        result.indexedCounts.hash = HashFight(sim.getPlayers(), sim.getEnemies(), sim.getBullets());
+        result.dropped = sim.getEvents().dropped();
+        
+        for(LoadResult* load : { &result.indexed, &result.nested })
+        {
+            load->ticks = rounds;
+            load->observe(sim);
+        }
+        return result;
+    }
+    
+    // half an hour of one match; breakthroughs never end it, so late ticks run on the same state as early ones
+    constexpr int32 SoakTicks = TickRate*60*30;
+    
+    // the default wave table reaches its last row at 91 seconds, segments before this are still ramping up
+    constexpr int32 SoakWarmUpTicks = TickRate*60*2;
+    
+    // generous ceilings, a leak or runaway spawning goes far past them long before the half hour
+    constexpr size_t SoakMaxUnits = 5000;
+    constexpr size_t SoakMaxBullets = 50000;
+    
+    // how much the last segment may exceed the first one after warm-up; a slow leak or a slowdown that
+    // stays under the ceilings still shows up as growth between the two
+    constexpr double SoakMaxGrowth = 2.0;
+    
+    // one GrowthInterval of the soak
+    struct SoakSegment
+    {
+        int32 tick = 0;
+        double msPerTick = 0.0;
+        size_t units = 0;
+        
+        // bullet slots including free ones, the free lists and the expiry heap
+        size_t bulletSlots = 0;
+        size_t freeSlots = 0;
+        size_t expiries = 0;
+        
+        // heap allocations on the simulation thread during the segment
+        uint64 allocations = 0;
+    };
+    
+    struct SoakResult
+    {
+        LoadResult load;
+        SoakSegment first;
+        SoakSegment last;
+        
+        // the slowest segment, as mean ms per tick
+        double worstSegmentMs = 0.0;
+        
+        bool isBounded() const
+        {
+            return load.peakPlayers <= SoakMaxUnits && load.peakEnemies <= SoakMaxUnits && load.peakBullets <= SoakMaxBullets
+                && worstSegmentMs <= TickDuration * 1000.0;
+        }
+        
+        // a tick's worth of slack on the counts, so a handful of extra allocations or slots on a flat run
+        // does not fail it
+        bool isFlat() const
+        {
+            const auto grows = [](double firstValue, double lastValue){ return firstValue * SoakMaxGrowth + GrowthInterval < lastValue; };
+            return last.msPerTick <= first.msPerTick * SoakMaxGrowth
+                && !grows(static_cast<double>(first.bulletSlots), static_cast<double>(last.bulletSlots))
+                && !grows(static_cast<double>(first.expiries), static_cast<double>(last.expiries))
+                && !grows(static_cast<double>(first.allocations), static_cast<double>(last.allocations));
+        }
+    };
+    
+    inline SoakResult RunSoak(JobSystem* jobs, TextWriter& growth)
+    {
+        SoakResult result;
+        result.load.name = U"soak_30min";
+        size_t mixedNext = 0;
+        
+        Simulation sim(1);
+        sim.setJobSystem(jobs);
+        sim.setEndless(true);
+        
+        result.load.startClock();
+        auto segmentStart = result.load.startedAt;
+        uint64 segmentAllocations = HeapStats::ThreadAllocations();
+        
+        for (int32 tick = 1; tick <= SoakTicks; ++tick)
+        {
+            sim.step(Decide(AutoPolicy::Mixed, sim, mixedNext));
+            sim.clearEvents();
+            
+            result.load.ticks = tick;
+            result.load.observe(sim);
+            
+            if(tick % GrowthInterval == 0)
+            {
+                const auto now = std::chrono::steady_clock::now();
+                const double seconds = std::chrono::duration<double>(now - segmentStart).count();
+                const BulletStore& bullets = sim.getBullets();
+                
+                SoakSegment segment;
+                segment.tick = tick;
+                segment.msPerTick = seconds * 1000.0 / GrowthInterval;
+                segment.units = sim.getPlayers().size() + sim.getEnemies().size();
+                segment.bulletSlots = bullets.slotCount();
+                segment.freeSlots = bullets.freeCount();
+                segment.expiries = bullets.expiryCount();
+                segment.allocations = HeapStats::ThreadAllocations() - segmentAllocations;
+                
+                result.worstSegmentMs = Max(result.worstSegmentMs, segment.msPerTick);
+                if(SoakWarmUpTicks < tick && result.first.tick == 0)
+                {
+                    result.first = segment;
+                }
+                result.last = segment;
+                
+                growth.writeln(U"{},{},{},{},{},{:.1f},,"_fmt(result.load.name, tick, sim.getPlayers().size(), sim.getEnemies().size(), bullets.count(), GrowthInterval / seconds));
+                segmentStart = now;
+                segmentAllocations = HeapStats::ThreadAllocations();
+            }
+        }
+        
+        result.load.stopClock();
+        return result;
+    }
+    
+    struct ThreadResult
+    {
+        LoadResult load;
+        uint64 hash = 0;
+    };
+    
+    // the 10k fight on the calling thread alone or on a pool; parallel phases only split work they
+    // merge back in order, so the final state hash must not depend on the thread count
+    inline ThreadResult RunThreads(JobSystem* jobs)
+    {
+        const LoadScenario fight{ U"threads", AutoPolicy::None, 1.0, 120, 10000, 10000 };
+        
+        Simulation sim(1);
+        sim.setJobSystem(jobs);
+        SetUpFight(sim, fight);
+        
+        ThreadResult result;
+        result.load.name = jobs ? U"threads_{}"_fmt(jobs->threadCount()) : U"threads_serial";
+        
+        result.load.startClock();
+        for (int32 tick = 1; tick <= fight.ticks && !sim.isGameOver(); ++tick)
+        {
+            sim.step(SimInput());
+            sim.clearEvents();
+            
+            result.load.ticks = tick;
+            result.load.observe(sim);
+        }
+        result.load.stopClock();
+        result.hash = sim.stateHash();
+        return result;
+    }
+    
+    constexpr int32 SnapshotRounds = 100;
+    
+    // save and load of a 10k unit, 10k bullet fight, reported like a scenario with one tick per round trip
+    inline LoadResult RunSnapshot()
+    {
+        Simulation sim(1);
+        SetUpFight(sim, LoadScenario{ U"snapshot_10k", AutoPolicy::None, 1.0, 0, 10000, 10000 });
+        
+        Array<uint8> bytes;
+        sim.saveSnapshot(bytes);
+        
+        LoadResult result;
+        result.name = U"snapshot_10k";
+        result.ticks = SnapshotRounds;
+        
+        result.startClock();
+        for (auto i : step(SnapshotRounds))
+        {
+            sim.saveSnapshot(bytes);
+            sim.loadSnapshot(bytes);
+        }
+        result.stopClock();
+        
+        result.observe(sim);
+        return result;
+    }
+    
+    struct SpawnResult
+    {
+        LoadResult load;
+        double spawnMaxMs = 0.0;
+        double allocationsPerTick = 0.0;
+    };
+    
+    // the director at a multiple of the normal spawn rate against a player spamming cards; the spawn
+    // phase should stay flat and steady ticks should not touch the heap
+    inline SpawnResult RunSpawnRate(double rate, int32 ticks)
+    {
+        WaveTable waves = WaveTable::Default();
+        waves.rate = rate;
+        
+        Simulation sim(1, waves);
+        PhaseProfiler profiler;
+        sim.setProfiler(&profiler);
+        
+        SpawnResult result;
+        result.load.name = U"spawn_rate{}"_fmt(rate);
+        size_t mixedNext = 0;
+        uint64 allocations = 0;
+        
+        result.load.startClock();
+        for (int32 tick = 1; tick <= ticks && !sim.isGameOver(); ++tick)
+        {
+            const SimInput input = Decide(AutoPolicy::SpamGeki, sim, mixedNext);
+            const uint64 before = HeapStats::ThreadAllocations();
+            
+            profiler.beginFrame();
+            sim.step(input);
+            sim.clearEvents();
+            profiler.endFrame();
+            
+            // the first second fills the reserves and the arena
+            if(TickRate < tick)
+            {
+                allocations += HeapStats::ThreadAllocations() - before;
+            }
+            
+            result.load.ticks = tick;
+            result.load.phaseMs[static_cast<size_t>(FramePhase::Spawn)] += profiler.lastTime(FramePhase::Spawn);
+            result.spawnMaxMs = Max(result.spawnMaxMs, profiler.lastTime(FramePhase::Spawn));
+            result.load.observe(sim);
+        }
+        
+        result.load.stopClock();
+        result.load.phaseMs[static_cast<size_t>(FramePhase::Spawn)] /= Max(result.load.ticks, 1);
+        result.allocationsPerTick = static_cast<double>(allocations) / Max(result.load.ticks - TickRate, 1);
+        return result;
+    }
+    
+    // units per variant, and how many of them also get a 100pt Font; a handful is enough to show
+    // what one costs without holding a thousand live fonts
+    constexpr size_t SpawnCostUnits = 1000;
+    constexpr size_t SpawnCostFonts = 20;
+    
+    struct SpawnCostVariant
+    {
+        size_t spawns = 0;
+        double usPerSpawn = 0.0;
+        double allocationsPerSpawn = 0.0;
+        double bytesPerSpawn = 0.0;
+        
+        // resident memory before and after the spawns, while they are all still alive
+        uint64 residentBefore = 0;
+        uint64 residentAfter = 0;
+    };
+    
+    struct SpawnCostResult
+    {
+        SpawnCostVariant unit;
+        
+        // the same spawns with a 100pt Font built next to each unit, as every Player used to hold one
+        SpawnCostVariant font;
+    };
+    
+    inline SpawnCostVariant MeasureSpawnCost(size_t spawns, bool withFont)
+    {
+        const Vec2 pos(-50, LaneHeight/2+100);
+        Array<Player> units;
+        Array<Font> fonts;
+        
+        SpawnCostVariant result;
+        result.spawns = spawns;
+        result.residentBefore = HeapStats::ResidentBytes();
+        
+        const uint64 allocationsBefore = HeapStats::ThreadAllocations();
+        const uint64 bytesBefore = HeapStats::ThreadBytes();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < spawns; ++i)
+        {
+            units.emplace_back(static_cast<UnitKind>(i % UnitArchetypes.size()), 1, false, pos);
+            if(withFont)
+            {
+                fonts.emplace_back(100, Typeface::Bold);
+            }
+        }
+        const double perSpawn = 1.0 / Max<size_t>(spawns, 1);
+        result.usPerSpawn = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() * perSpawn;
+        result.allocationsPerSpawn = (HeapStats::ThreadAllocations() - allocationsBefore) * perSpawn;
+        result.bytesPerSpawn = (HeapStats::ThreadBytes() - bytesBefore) * perSpawn;
+        result.residentAfter = HeapStats::ResidentBytes();
+        
+        return result;
+    }
+    
+    inline SpawnCostResult RunSpawnCost()
+    {
+        SpawnCostResult result;
+        result.unit = MeasureSpawnCost(SpawnCostUnits, false);
+        result.font = MeasureSpawnCost(SpawnCostFonts, true);
+        return result;
+    }
+    
+    struct SweepResult
+    {
+        int32 interval;
+        size_t sweptHits;
+        size_t pointHits;
+    };
+    
+    // a multiple of every interval, so the last stretch of each path is checked too
+    constexpr int32 SweepTicks = 320;
+    
+    // bullets on every lane at up to 60 px per tick against fixed targets, checked every interval ticks the
+    // way Simulation does; swept hits have to come out exactly the same for every interval, point hits
+    // only look at where the bullet is now and show the tunnelling
+    inline Array<SweepResult> RunSweep()
+    {
+        const double y = LaneHeight/2+100;
+        Array<Vec2> targets;
+        for (int32 x = 200; x < LaneWidth; x += 150)
+        {
+            targets << Vec2(x, y);
+        }
+        
+        Array<SweepResult> results;
+        for(const int32 interval : { 1, 2, 4, 8 })
+        {
+            SweepResult result{ interval, 0, 0 };
+            
+            // point hits kill other bullets than swept ones, so each uses a store of its own
+            for(const bool isSwept : { true, false })
+            {
+                BulletStore bullets;
+                SimRandom random(7);
+                
+                for (int32 i = 0; i < 2000; ++i)
+                {
+                    const BulletType type = static_cast<BulletType>(i % BulletStore::LaneCount);
+                    const bool isFall = (type == BulletType::Fall || type == BulletType::FallThrow);
+                    const double speeds[] = { 10.0, 12.0, 30.0, 60.0 };
+                    const Vec2 pos(random.range(-50, LaneWidth/2), isFall ? y - random.range(100, 400) : y + random.range(-20, 20));
+                    bullets.spawn(type, false, false, pos, speeds[i / BulletStore::LaneCount % 4]);
+                }
+                
+                size_t& hits = isSwept ? result.sweptHits : result.pointHits;
+                for (int32 tick = 1; tick <= SweepTicks; ++tick)
+                {
+                    const bool isCheck = (tick % interval == 0);
+                    if(isCheck)
+                    {
+                        for(auto& lane : bullets.getLanes())
+                        {
+                            for (size_t b = 0; b < lane.size(); ++b)
+                            {
+                                for (size_t t = 0; lane.alive[b] && t < targets.size(); ++t)
+                                {
+                                    const bool isHit = isSwept
+                                        ? bullets.sweptHit(lane, b, bullets.now() - interval, targets[t], 50.0)
+                                        : bullets.position(lane, b).distanceFrom(targets[t]) <= 50.0;
+                                    if(isHit)
+                                    {
+                                        bullets.kill(lane, b);
+                                        ++hits;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                    
+                    bullets.update();
+                    bullets.removeDead(isCheck);
+                }
+            }
+            
+            results << result;
+        }
+        
+        return results;
+    }
+    
+    struct SweepFightResult
+    {
+        int32 interval;
+        size_t hits = 0;
+        size_t kills = 0;
+        LoadResult load;
+    };
+    
+    // units keep walking and firing between checks, so a coarser interval moves when a hit lands by a few
+    // ticks and the fight drifts a little; tunnelling would lose far more hits than this
+    constexpr double SweepTolerance = 0.05;
+    
+    // an extra check on top of RunSweep: the 1k fight with bullet collision checked every 1, 2, 4 and
+    // 8 ticks has to give about the same hit and kill counts whatever the interval
+    inline Array<SweepFightResult> RunSweepFight()
+    {
+        const LoadScenario fight{ U"sweep", AutoPolicy::None, 1.0, TickRate*5, 1000, 1000 };
+        
+        Array<SweepFightResult> results;
+        for(const int32 interval : { 1, 2, 4, 8 })
+        {
+            Simulation sim(1);
+            sim.setCollisionInterval(interval);
+            SetUpFight(sim, fight);
+            
+            SweepFightResult result{ interval };
+            result.load.name = U"sweep_every{}"_fmt(interval);
+            
+            result.load.startClock();
+            for (int32 tick = 1; tick <= fight.ticks && !sim.isGameOver(); ++tick)
+            {
+                sim.step(SimInput());
+                
+                for(const auto& event : sim.getEvents())
+                {
+                    result.hits += (event.type == SimEventType::Hit);
+                    result.kills += (event.type == SimEventType::Kill);
+                }
+                sim.clearEvents();
+                
+                result.load.ticks = tick;
+                result.load.observe(sim);
+            }
+            result.load.stopClock();
+            
+            results << result;
+        }
+        
+        return results;
+    }
+    
+    // true when count is within SweepTolerance of reference
+    inline bool IsClose(size_t count, size_t reference)
+    {
+        return std::abs(static_cast<double>(count) - static_cast<double>(reference)) <= SweepTolerance * Max<double>(reference, 1.0);
+    }
+    
+    struct LayoutResult
+    {
+        LoadResult soa;
+        LoadResult aos;
+        size_t soaHits = 0;
+        size_t aosHits = 0;
+    };
+    
+    // the same bullets moved and tested against one target each tick, once in the global struct-of-arrays
+    // store and once as whole bullet objects in an array per unit, the way units used to own them
+    inline LayoutResult RunBulletLayout(size_t units, size_t bulletsPerUnit, int32 ticks)
+    {
+        struct UnitBullet
+        {
+            Vec2 pos;
+            double speed;
+            double prevY;
+            double force;
+            BulletType type;
+            bool isEnemy;
+            bool isAlive;
+            
+            void update()
+            {
+                const double dir = isEnemy ? -1.0 : 1.0;
+                const double y = pos.y;
+                
+                switch (type)
+                {
+                    case BulletType::Throw:
+                        pos.moveBy(dir*speed, (pos.y - prevY) + force);
+                        prevY = y;
+                        force = 0.2;
+                        break;
+                    case BulletType::Fall:
+                        pos.moveBy(0, speed);
+                        break;
+                    case BulletType::FallThrow:
+                        pos.moveBy(dir*speed/2, speed);
+                        break;
+                    default:
+                        pos.moveBy(dir*speed, 0);
+                        break;
+                }
+            }
+        };
+        
+        const Vec2 target(LaneWidth/2, LaneHeight/2+100);
+        constexpr double HitRadiusSq = 50.0*50.0;
+        
+        BulletStore store;
+        Array<Array<UnitBullet>> owned(units);
+        SimRandom random(units ^ bulletsPerUnit);
+        
+        for (size_t u = 0; u < units; ++u)
+        {
+            const bool isEnemy = (u % 2 == 1);
+            for (size_t k = 0; k < bulletsPerUnit; ++k)
+            {
+                const BulletType type = static_cast<BulletType>(k % BulletStore::LaneCount);
+                const bool isFall = (type == BulletType::Fall || type == BulletType::FallThrow);
+                const Vec2 pos(random.range(0, LaneWidth), isFall ? target.y - random.range(100, 400) : target.y + random.range(-20, 20));
+                store.spawn(type, isEnemy, isEnemy, pos, 10.0);
+                owned[u].push_back(UnitBullet{pos, 10.0, pos.y, -12.0, type, isEnemy, true});
+            }
+        }
+        
+        LayoutResult result;
+        result.soa.name = U"bullets_soa_{}"_fmt(units*bulletsPerUnit);
+        result.aos.name = U"bullets_aos_{}"_fmt(units*bulletsPerUnit);
+        
+        result.soa.startClock();
+        for (int32 tick = 0; tick < ticks; ++tick)
+        {
+            store.update();
+            for(const auto& lane : store.getLanes())
+            {
+                for (size_t b = 0; b < lane.size(); ++b)
+                {
+                    result.soaHits += (lane.alive[b] && store.position(lane, b).distanceFromSq(target) <= HitRadiusSq);
+                }
+            }
+        }
+        result.soa.stopClock();
+        
+        result.aos.startClock();
+        for (int32 tick = 0; tick < ticks; ++tick)
+        {
+            for(auto& bullets : owned)
+            {
+                for(auto& bullet : bullets)
+                {
+                    bullet.update();
+                    result.aosHits += (bullet.isAlive && bullet.pos.distanceFromSq(target) <= HitRadiusSq);
+                }
+            }
+        }
+        result.aos.stopClock();
+        
+        for(LoadResult* load : { &result.soa, &result.aos })
+        {
+            load->ticks = ticks;
+            load->peakPlayers = units;
+            load->peakBullets = units*bulletsPerUnit;
+        }
+        return result;
+    }
+    
+    // a stand-in for Player with only what LaneIndex reads
+    struct LaneUnit
+    {
+        Vec2 pos;
+        double speed;
+        
+        bool alive() const
+        {
+            return true;
+        }
+        
+        const Vec2& getPos() const
+        {
+            return pos;
+        }
+    };
+    
+    // one unit in this many is knocked back each tick
+    constexpr int32 LaneKnockBackOdds = 100;
+    
+    struct LaneIndexResult
+    {
+        LoadResult indexed;
+        LoadResult linear;
+    };
+    
+    // units walk at game speeds, 1 to 8 px per tick by archetype and grade, so faster ones keep overtaking
+    // slower ones; some are knocked back by ten steps like Player::nockBack, and they turn round at the lane
+    // ends instead of breaking through so the count stays fixed
+    inline void MoveLaneUnits(Array<LaneUnit>& units, SimRandom& random)
+    {
+        for (auto& unit : units)
+        {
+            if(random.range(0, LaneKnockBackOdds-1) == 0)
+            {
+                unit.pos.x -= unit.speed * 10;
+            }
+            else
+            {
+                unit.pos.x += unit.speed;
+            }
+            
+            if((unit.pos.x < -50 && unit.speed < 0) || (LaneWidth+50 < unit.pos.x && 0 < unit.speed))
+            {
+                unit.speed = -unit.speed;
+            }
+        }
+    }
+    
+    inline std::pair<Array<LaneUnit>, Array<LaneUnit>> MakeLaneUnits(size_t units, SimRandom& random)
+    {
+        std::pair<Array<LaneUnit>, Array<LaneUnit>> sides;
+        for (size_t i = 0; i < units/2; ++i)
+        {
+            // archetype speed plus grade, drawn one at a time so both runs see the same sequence
+            const auto speed = [&random]()
+            {
+                const int32 base = random.range(1, 5);
+                return static_cast<double>(base + random.range(1, 3));
+            };
+            const double playerX = random.range(-50, LaneWidth/2);
+            const double playerSpeed = speed();
+            const double enemyX = random.range(LaneWidth/2, LaneWidth+50);
+            const double enemySpeed = speed();
+            sides.first.push_back(LaneUnit{Vec2(playerX, 0), playerSpeed});
+            sides.second.push_back(LaneUnit{Vec2(enemyX, 0), -enemySpeed});
+        }
+        return sides;
+    }
+    
+    // each tick every player looks up its nearest enemy, once through the repaired indices and once by
+    // scanning all enemies; the scan is n squared per tick, so it runs fewer ticks at the larger sizes
+    inline LaneIndexResult RunLaneIndex(size_t units, int32 ticks)
+    {
+        LaneIndexResult result;
+        size_t found = 0;
+        
+        {
+            SimRandom random(units);
+            auto [players, enemies] = MakeLaneUnits(units, random);
+            LaneIndex playerIndex, enemyIndex;
+            
+            result.indexed.name = U"lane_{}"_fmt(units);
+            result.indexed.ticks = ticks;
+            result.indexed.startClock();
+            for (int32 tick = 0; tick < ticks; ++tick)
+            {
+                MoveLaneUnits(players, random);
+                MoveLaneUnits(enemies, random);
+                
+                playerIndex.update(players);
+                enemyIndex.update(enemies);
+                
+                for (const auto& unit : players)
+                {
+                    found += enemyIndex.nearest(unit.pos.x);
+                }
+            }
+            result.indexed.stopClock();
+        }
+        
+        {
+            SimRandom random(units);
+            auto [players, enemies] = MakeLaneUnits(units, random);
+            const int32 linearTicks = static_cast<int32>(Clamp<size_t>(static_cast<size_t>(ticks) * 1000 * 1000 / Max<size_t>(units * units, 1), 1, static_cast<size_t>(ticks)));
+            
+            result.linear.name = U"lane_linear_{}"_fmt(units);
+            result.linear.ticks = linearTicks;
+            result.linear.startClock();
+            for (int32 tick = 0; tick < linearTicks; ++tick)
+            {
+                MoveLaneUnits(players, random);
+                MoveLaneUnits(enemies, random);
+                
+                for (const auto& unit : players)
+                {
+                    size_t nearest = LaneIndex::NotFound;
+                    double distance = std::numeric_limits<double>::infinity();
+                    for (size_t i = 0; i < enemies.size(); ++i)
+                    {
+                        const double d = std::abs(enemies[i].pos.x - unit.pos.x);
+                        if(d < distance)
+                        {
+                            distance = d;
+                            nearest = i;
+                        }
+                    }
+                    found += nearest;
+                }
+            }
+            result.linear.stopClock();
+        }
+        
+        for(LoadResult* load : { &result.indexed, &result.linear })
+        {
+            load->peakPlayers = units/2;
+            load->peakEnemies = units/2;
+        }
+        
+        // the queries have no other effect, so the result is stored where the optimiser cannot drop it
+        Sink = found;
+        return result;
+    }
+    
+    struct VersusScenario
+    {
+        String name;
+        int32 latency;
+        int32 inputDelay;
+        int32 ticks;
+    };
+    
+    // latency above the input delay is what gets rolled back, past MaxRollback more than that it stalls
+    inline const Array<VersusScenario> VersusScenarios =
+    {
+        { U"versus_lan",        0,  2, TickRate*120 },
+        { U"versus_l6_d2",      6,  2, TickRate*120 },
+        { U"versus_l10_d0",     10, 0, TickRate*120 },
+        { U"versus_l16_d2",     16, 2, TickRate*120 },
+    };
+    
+    struct VersusResult
+    {
+        LoadResult load;
+        RollbackStats rollback;
+        size_t checksums = 0;
+        size_t mismatches = 0;
+    };
+    
+    // two headless clients over a loopback link, both played by the mixed policy; every checksum the
+    // two ends confirmed for the same tick has to agree
+    inline VersusResult RunVersus(const VersusScenario& scenario)
+    {
+        Simulation sim(1, WaveTable::Default(), SimMode::Versus);
+        LoopbackMatch match(sim, WaveTable::Default(), scenario.latency, scenario.inputDelay);
+        
+        VersusResult result;
+        result.load.name = scenario.name;
+        size_t mixedNext = 0, rivalNext = 2;
+        Optional<SimInput> input;
+        
+        result.load.startClock();
+        
+        for (int32 frame = 1; frame <= scenario.ticks && !sim.isGameOver(); ++frame)
+        {
+            if(!input)
+            {
+                input = Decide(AutoPolicy::Mixed, sim, mixedNext);
+            }
+            
+            if(match.advance(*input, [&](const Simulation& rivalSim){ return Decide(AutoPolicy::Mixed, rivalSim, rivalNext, true); }))
+            {
+                input.reset();
+            }
+            sim.clearEvents();
+            
+            result.load.ticks = sim.getTick();
+            result.load.observe(sim);
+        }
+        
+        result.load.stopClock();
+        result.rollback = match.local().stats();
+        
+        const auto& local = match.local().checksums();
+        const auto& rival = match.rival().checksums();
+        for (size_t i = 0; i < Min(local.size(), rival.size()); ++i)
+        {
+            ++result.checksums;
+            if(local[i] != rival[i])
+            {
+                ++result.mismatches;
+            }
+        }
+        
+        return result;
+    }
+    
+    // replays a scripted match headless and renders a frame every GoldenInterval ticks with the software
+    // rasteriser; the first run writes golden/<tick>.png, later runs compare against them and write
+    // golden/<tick>_actual.png on a mismatch. draw list building and rasterising are timed separately;
+    // drawScene(sim, batch) adds the units and bullets the way the game draws them. returns the frames that differ
+    template <class Fty>
+    size_t RenderGoldenFrames(JobSystem& jobs, Fty&& drawScene)
+    {
+        constexpr int32 GoldenInterval = TickRate*10;
+        constexpr int32 GoldenTicks = TickRate*60;
+        
+        Simulation sim(1);
+        ParticlePool particles(8192);
+        EventMixer mixer;
+        FrameArena arena(256*1024);
+        RenderBatch batch;
+        SoftwareRaster raster(Size(LaneWidth, LaneHeight));
+        raster.setJobSystem(&jobs);
+        batch.setSoftwareTarget(&raster);
+        
+        FileSystem::CreateDirectories(U"golden/");
+        size_t mixedNext = 0;
+        double listMs = 0.0, rasterMs = 0.0;
+        int32 frames = 0;
+        size_t mismatches = 0;
+        
+        for (int32 tick = 1; tick <= GoldenTicks && !sim.isGameOver(); ++tick)
+        {
+            sim.step(Decide(AutoPolicy::Mixed, sim, mixedNext));
+            mixer.consume(sim.getEvents(), particles, arena, TickDuration);
+            sim.clearEvents();
+            particles.update(TickDuration);
+            arena.reset();
+            
+            if(tick % GoldenInterval != 0)
+            {
+                continue;
+            }
+            
+            raster.clear(Palette::Whitesmoke);
+            
+            const auto listStart = std::chrono::steady_clock::now();
+            drawScene(sim, batch);
+            particles.draw(batch);
+            batch.endFrame();
+            
+            const auto rasterStart = std::chrono::steady_clock::now();
+            raster.resolve();
+            const auto rasterEnd = std::chrono::steady_clock::now();
+            listMs += std::chrono::duration<double, std::milli>(rasterStart - listStart).count();
+            rasterMs += std::chrono::duration<double, std::milli>(rasterEnd - rasterStart).count();
+            ++frames;
+            
+            const FilePath golden = U"golden/{}.png"_fmt(tick);
+            if(!FileSystem::Exists(golden))
+            {
+                raster.image().save(golden);
+                Console << U"golden {} : new"_fmt(tick);
+                continue;
+            }
+            
+            const size_t differences = raster.countDifferences(Image(golden));
+            if(differences != 0)
+            {
+                ++mismatches;
+                raster.image().save(U"golden/{}_actual.png"_fmt(tick));
+            }
+            Console << U"golden {} : {} px differ{}"_fmt(tick, differences, differences ? U"  MISMATCH" : U"");
+        }
+        
+        Console << U"golden frames : {:.3f} ms draw list, {:.3f} ms raster per frame"_fmt(listMs / Max(frames, 1), rasterMs / Max(frames, 1));
+        return mismatches;
+    }
+    
+    // ticks per second by scenario name from an earlier results file
+    inline HashTable<String, double> LoadBaseline(const FilePath& path)
+    {
+        HashTable<String, double> baseline;
+        const CSVData csv(path);
+        
+        for (size_t row = 1; csv && row < csv.rows(); ++row)
+        {
+            if(4 <= csv.columns(row))
+            {
+                if(const auto ticksPerSecond = ParseOpt<double>(csv[row][3]))
+                {
+                    baseline.emplace(csv[row][0], *ticksPerSecond);
+                }
+            }
+        }
+        
+        return baseline;
+    }
+}
+
+// runs every scenario with no rendering, writes one summary row per scenario to resultPath and the
+// counts over time to growthPath; copy a results file to baselinePath to compare later runs against it.
+// drawScene(sim, batch) draws a frame for the golden image check. returns how many checks failed,
+// the last row of resultPath holds the same count
+template <class Fty>
+size_t RunLoadTests(Fty&& drawScene, const FilePath& resultPath = U"loadtest.csv", const FilePath& growthPath = U"loadtest_growth.csv", const FilePath& baselinePath = U"loadtest_baseline.csv")
+{
+    JobSystem jobs;
+    const HashTable<String, double> baseline = LoadTest::LoadBaseline(baselinePath);
+    
+    TextWriter results(resultPath);
+    TextWriter growth(growthPath);
+    
+    String header = U"scenario,ticks,seconds,ticks_per_sec,peak_players,peak_enemies,peak_bullets";
+    for(const auto& name : PhaseProfiler::PhaseNames)
+    {
+        header += U"," + name.toString() + U"_ms";
+    }
+    results.writeln(header);
+    growth.writeln(U"scenario,tick,players,enemies,bullets,ticks_per_sec,collision_p50_ms,update_p50_ms");
+    
+    Console.open();
+    
+    size_t failures = 0;
+    
+    // counts a failed check and gives the tag that goes after its console line
+    const auto check = [&failures](bool isOk, StringView tag)
+    {
+        failures += !isOk;
+        return isOk ? String() : U"  " + String(tag);
+    };
+    
+    const auto report = [&](const LoadResult& result)
+    {
+        String row = U"{},{},{:.3f},{:.1f},{},{},{}"_fmt(result.name, result.ticks, result.seconds, result.ticksPerSecond(), result.peakPlayers, result.peakEnemies, result.peakBullets);
+        for(const auto& ms : result.phaseMs)
+        {
+            row += U",{:.4f}"_fmt(ms);
+        }
+        results.writeln(row);
+        
+        String line = U"{:<16} {:>10.1f} ticks/s  peak {}/{}/{}"_fmt(result.name, result.ticksPerSecond(), result.peakPlayers, result.peakEnemies, result.peakBullets);
+        if(const auto it = baseline.find(result.name); it != baseline.end() && 0.0 < it->second)
+        {
+            const double ratio = result.ticksPerSecond() / it->second;
+            line += U"  x{:.2f} vs baseline{}"_fmt(ratio, (ratio < 0.9) ? U"  REGRESSION" : U"");
+        }
+        Console << line;
+    };
+    
+    for(const auto& scenario : LoadTest::Scenarios)
+    {
+        report(LoadTest::Run(scenario, &jobs, growth));
+    }
+    
+    // one collision pass through the lane indices against the nested loops they replaced, which have
+    // to find the same hits and kills and leave the same units and bullets behind
+    const std::array<std::pair<size_t, int32>, 3> collisionSizes = {{ { 100, 100 }, { 1000, 10 }, { 10000, 1 } }};
+    for(const auto& [units, rounds] : collisionSizes)
+    {
+        const LoadTest::CollisionResult collision = LoadTest::RunCollision(units, rounds);
+        report(collision.indexed);
+        report(collision.nested);
+        Console << U"  {:.4f} ms indexed, {:.4f} ms nested per pass, {}/{} hits, {}/{} kills{}"_fmt(
+            collision.indexed.seconds * 1000.0 / rounds, collision.nested.seconds * 1000.0 / rounds,
+            collision.indexedCounts.hits, collision.nestedCounts.hits, collision.indexedCounts.kills, collision.nestedCounts.kills,
+            check(collision.isMatching(), U"MISMATCH"));
+    }
+    
+    // the same fight with no pool and with 1, 2, 4 and every worker has to end in the same state
+    const LoadTest::ThreadResult serial = LoadTest::RunThreads(nullptr);
+    report(serial.load);
+    for(const size_t workers : { size_t(1), size_t(2), size_t(4), jobs.threadCount()-1 })
+    {
+        JobSystem pool(workers);
+        const LoadTest::ThreadResult threaded = LoadTest::RunThreads(&pool);
+        report(threaded.load);
+        Console << U"  hash {:016X}{}"_fmt(threaded.hash, check(threaded.hash == serial.hash, U"DESYNC"));
+    }
+    
+    // entity counts and tick time have to stay flat over a long session
+    const LoadTest::SoakResult soak = LoadTest::RunSoak(&jobs, growth);
+    report(soak.load);
+    Console << U"  worst {:.3f} ms/tick over {} ticks{}"_fmt(soak.worstSegmentMs, LoadTest::GrowthInterval, check(soak.isBounded(), U"UNBOUNDED"));
+    for(const LoadTest::SoakSegment* segment : { &soak.first, &soak.last })
+    {
+        Console << U"  tick {}: {:.3f} ms/tick, {} units, {} bullet slots ({} free), {} expiries, {} heap allocs"_fmt(segment->tick, segment->msPerTick, segment->units, segment->bulletSlots, segment->freeSlots, segment->expiries, segment->allocations);
+    }
+    Console << U"  last/first {:.2f}x ms/tick{}"_fmt(soak.last.msPerTick / Max(soak.first.msPerTick, 1e-9), check(soak.isFlat(), U"GROWING"));
+    
+    // one save plus one load has to stay under a millisecond
+    const LoadResult snapshot = LoadTest::RunSnapshot();
+    report(snapshot);
+    const double roundTripMs = snapshot.seconds * 1000.0 / snapshot.ticks;
+    Console << U"snapshot save+load : {:.3f} ms{}"_fmt(roundTripMs, check(roundTripMs <= 1.0, U"OVER BUDGET"));
+    
+    for(const double rate : { 1.0, 10.0, 100.0 })
+    {
+        const LoadTest::SpawnResult spawn = LoadTest::RunSpawnRate(rate, TickRate*60);
+        report(spawn.load);
+        Console << U"  spawn {:.4f} ms mean, {:.4f} ms max, {:.2f} heap allocs/tick"_fmt(spawn.load.phaseMs[static_cast<size_t>(FramePhase::Spawn)], spawn.spawnMaxMs, spawn.allocationsPerTick);
+    }
+    
+    // what a unit costs to spawn and to keep, against the font it used to carry
+    const LoadTest::SpawnCostResult spawnCost = LoadTest::RunSpawnCost();
+    Console << U"spawn cost : {} bytes per unit"_fmt(sizeof(Player));
+    for(const auto& variant : { std::make_pair(U"unit", spawnCost.unit), std::make_pair(U"with a Font", spawnCost.font) })
+    {
+        const LoadTest::SpawnCostVariant& cost = variant.second;
+        Console << U"  {} x{} : {:.3f} us, {:.2f} heap allocs, {:.0f} heap bytes each; resident {} KiB -> {} KiB"_fmt(variant.first, cost.spawns,
+            cost.usPerSpawn, cost.allocationsPerSpawn, cost.bytesPerSpawn, cost.residentBefore / 1024, cost.residentAfter / 1024);
+    }
+    
+    // continuous collision has to give exactly the same hits against fixed targets whatever the interval
+    const Array<LoadTest::SweepResult> sweeps = LoadTest::RunSweep();
+    for(const auto& sweep : sweeps)
+    {
+        Console << U"sweep every {} : {} swept hits, {} point hits{}"_fmt(sweep.interval, sweep.sweptHits, sweep.pointHits,
+            check(sweep.sweptHits == sweeps.front().sweptHits, U"MISMATCH"));
+    }
+    
+    // and about the same in a real fight, where the units move between checks
+    const Array<LoadTest::SweepFightResult> sweepFights = LoadTest::RunSweepFight();
+    for(const auto& sweep : sweepFights)
+    {
+        report(sweep.load);
+        const bool isOk = LoadTest::IsClose(sweep.hits, sweepFights.front().hits) && LoadTest::IsClose(sweep.kills, sweepFights.front().kills);
+        Console << U"  {} hits, {} kills{}"_fmt(sweep.hits, sweep.kills, check(isOk, U"MISMATCH"));
+    }
+    
+    // moving and testing bullets in the shared store against the per-unit arrays it replaced
+    for(const size_t units : { 100, 1000 })
+    {
+        const LoadTest::LayoutResult layout = LoadTest::RunBulletLayout(units, 100, 120);
+        report(layout.soa);
+        report(layout.aos);
+        Console << U"  soa x{:.2f} vs aos, hits {}/{}"_fmt(layout.soa.ticksPerSecond() / Max(layout.aos.ticksPerSecond(), 1e-9), layout.soaHits, layout.aosHits);
+    }
+    
+    // one nearest() per unit makes n log n per tick the floor for the index; the insertion-sort repair adds
+    // a shift for every unit that overtook or was knocked past another, the linear scan is n squared
+    for(const size_t units : { 1000, 10000, 100000 })
+    {
+        const LoadTest::LaneIndexResult lane = LoadTest::RunLaneIndex(units, 300);
+        report(lane.indexed);
+        report(lane.linear);
+        Console << U"  index x{:.1f} vs linear scan"_fmt(lane.indexed.ticksPerSecond() / Max(lane.linear.ticksPerSecond(), 1e-9));
+    }
+    
+    for(const auto& scenario : LoadTest::VersusScenarios)
+    {
+        const LoadTest::VersusResult versus = LoadTest::RunVersus(scenario);
+        report(versus.load);
+        
+        const RollbackStats& rollback = versus.rollback;
+        Console << U"  rollback {:.4f} ms/tick, max {:.3f} ms, {} rollbacks, {} resimulated, {} stalls, checksums {}/{}{}"_fmt(
+            rollback.meanMsPerTick(), rollback.maxRollbackMs, rollback.rollbacks, rollback.resimulatedTicks, rollback.stalls,
+            versus.checksums - versus.mismatches, versus.checksums, check(versus.mismatches == 0, U"DESYNC"));
+    }
+    
+    // every frame that no longer matches its golden image is a failed check
+    failures += LoadTest::RenderGoldenFrames(jobs, drawScene);
+    
+    results.writeln(U"failed_checks,{}"_fmt(failures));
+    Console << U"load test : {} failed checks"_fmt(failures);
+    return failures;
+}
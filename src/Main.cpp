@@ -1,427 +1,292 @@
 # include <Siv3D.hpp>
+# include "Simulation.hpp"
+# include "RenderBatch.hpp"
+# include "ParticlePool.hpp"
+# include "Replay.hpp"
+# include "EventMixer.hpp"
+# include "AssetLoader.hpp"
+# include "LoadTest.hpp"
+# include "FrameArena.hpp"
+# include "Rewind.hpp"
+# include "HudLayer.hpp"
+# include "Netplay.hpp"
+# include "SoftwareRaster.hpp"
 
-enum class BulletType
+// counted so the debug line can show how many heap allocations a frame makes
+void* operator new(std::size_t size)
 {
-    Normal,
-    Throw,
-    Fall,
-    FallThrow,
-};
-
-class Bullet
-{
-public:
-    Bullet(bool isEnemy = false, Vec2 pos = Vec2(0,0), double speed=10.0, BulletType bulletType=BulletType::Normal)
-    :m_isEnemy(isEnemy)
-    ,m_pos(pos)
-    ,m_speed(speed)
-    ,m_prevPosY(pos.y)
-    ,m_fouce(-12.0)
-    ,m_bulletType(bulletType)
-    ,m_isAlive(true)
-    {}
+    HeapStats::allocations.fetch_add(1, std::memory_order_relaxed);
+    ++HeapStats::threadAllocations;
+    HeapStats::threadBytes += size;
     
-    const bool alive()
+    if(void* p = std::malloc(size ? size : 1))
     {
-        return m_isAlive;
+        return p;
     }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+template <class ShapeType>
+class HighlightingShape : public ShapeType
+{
+private:
+
+    Transition m_transition = Transition(0.2s, 0.1s);
     
-    const Vec2 getPos()
-    {
-        return m_pos;
-    }
+public:
+
+    HighlightingShape() = default;
     
-    void dead()
-    {
-        m_isAlive = false;
-    }
+    explicit HighlightingShape(const ShapeType& shape)
+    : ShapeType(shape) {}
+    
+    template <class ...Args>
+    explicit HighlightingShape(Args&&... args)
+    : ShapeType(std::forward<Args>(args)...) {}
     
     void update()
     {
-        if(m_isAlive)
-        {
-            double yTemp = m_pos.y;
-            
-            switch (m_bulletType)
-            {
-                case BulletType::Normal:
-                    m_pos.moveBy(m_isEnemy ? -m_speed : m_speed, 0);
-                    break;
-                case BulletType::Throw:
-                    m_pos.moveBy(m_isEnemy ? -m_speed : m_speed, (m_pos.y - m_prevPosY) + m_fouce);
-                    m_prevPosY = yTemp;
-                    m_fouce = 0.2;
-                    break;
-                case BulletType::Fall:
-                    m_pos.moveBy(0, m_speed);
-                    break;
-                case BulletType::FallThrow:
-                    m_pos.moveBy(m_isEnemy ? -m_speed/2 : m_speed/2, m_speed);
-                    break;
-                default:
-                    m_pos.moveBy(m_isEnemy ? -m_speed : m_speed, 0);
-                    break;
-            }
-            
-        }
+        m_transition.update(ShapeType::mouseOver());
     }
     
-    const void draw()
-    {
-        if(m_isAlive) RectF(m_pos-Vec2(20,20),40,40).rotated(System::FrameCount()*1.0_deg).draw(m_isEnemy ? Palette::Blue : Palette::Red);
-    }
-private:
-    const bool m_isEnemy;
-    const BulletType m_bulletType;
-    Vec2 m_pos;
-    bool m_isAlive;
-    double m_speed;
-    double m_fouce;
-    double m_prevPosY;
-};
-
-class Player
-{
-public:
-    Player(String name=U"打", int32 grade=1, bool isEnemy = false, Vec2 pos = Vec2(0,0))
-    :m_font(100,Typeface::Bold)
-    ,m_name(name)
-    ,m_grade(grade)
-    ,m_isEnemy(isEnemy)
-    ,m_pos(Vec2(pos.x,0))
-    ,m_fallPos(pos.y)
-    ,m_isAlive(true)
+    void drawHighlight(Color color) const
     {
-        if(m_name==U"打")
-        {
-            m_speed = isEnemy ? -2.0 : 2.0;
-            m_hp = 10+5*grade;
-        }
-        else if(m_name==U"撃")
-        {
-            m_speed = isEnemy ? -1.5 : 1.5;
-            m_hp = 10;
-        }
-        else if(m_name==U"射")
-        {
-            m_speed = isEnemy ? -1.0 : 1.0;
-            m_hp = 5;
-        }
-        else if(m_name==U"伐")
-        {
-            m_speed = grade + (isEnemy ? -5.0 : 5.0);
-            m_hp = 25;
-        }
-        else if(m_name==U"征")
-        {
-            m_speed = isEnemy ? -3.0 : 3.0;
-            m_hp = 5;
-            m_fallPos -= 200;
-        }
+        drawOutline(color);
         
-        m_coolTime.start();
-    }
-    
-    const bool alive()
-    {
-        return m_isAlive;
-    }
-    
-    const Vec2 getPos()
-    {
-        return m_pos;
+        drawFill(color);
     }
     
-    Array<Bullet>& getBullets()
+    void drawOutline(Color color) const
     {
-        return m_bullets;
+        ShapeType::drawFrame(0, 10, color);
     }
     
-    int32 getGrade()
+    void drawFill(Color color) const
     {
-        return m_grade;
+        ShapeType::draw(ColorF(color, m_transition.value() * 0.25));
     }
     
-    bool nockBack(int32 damage)
+    const bool shapeClicked()
     {
-        m_hp -= damage;
-        if(m_hp <= 0)
-        {
-            m_isAlive = false;
-            return true;
-        }
-        m_pos.moveBy(-m_speed*10, 0);
-        return false;
+        return ShapeType::leftClicked();
     }
     
-    void dead()
+    const Transition& getTransition() const
     {
-        m_isAlive = false;
+        return m_transition;
     }
+};
+
+// every unit draws from this one font, the fixed glyph set is rasterised up front
+class UnitGlyphs
+{
+public:
+    UnitGlyphs()
+    : m_font(100,Typeface::Bold)
+    , m_chars(U"打撃射伐征激超鬱")
+    , m_glyphs(m_font.getGlyphs(m_chars))
+    {}
     
-    void update()
+    void drawAt(RenderBatch& batch, char32 ch, const Vec2& pos, const ColorF& color) const
     {
-        if(m_isAlive)
+        for (auto i : step(m_chars.size()))
         {
-            if(m_name==U"撃")
+            if(m_chars[i] == ch)
             {
-                if(2000/m_grade < m_coolTime.ms())
-                {
-                    m_coolTime.restart();
-                    m_bullets.push_back(Bullet(m_isEnemy,m_pos,10.0,BulletType::Normal));
-                }
+                const Glyph& glyph = m_glyphs[i];
+                const Vec2 penPos = pos - Vec2(glyph.xAdvance, m_font.height())/2;
+                batch.addTexture(glyph.texture, penPos + glyph.offset, color);
+                return;
             }
-            else if(m_name==U"射")
-            {
-                if(4000 < m_coolTime.ms())
-                {
-                    m_coolTime.restart();
-                    m_bullets.push_back(Bullet(m_isEnemy,m_pos,3.0,BulletType::Throw));
-                    m_bullets.push_back(Bullet(m_isEnemy,m_pos,6.0,BulletType::Throw));
-                    m_bullets.push_back(Bullet(m_isEnemy,m_pos,9.0,BulletType::Throw));
-                    if(2 <= m_grade)
-                    {
-                        m_bullets.push_back(Bullet(m_isEnemy,m_pos,1.0,BulletType::Throw));
-                    }
-                    if(3 <= m_grade)
-                    {
-                        m_bullets.push_back(Bullet(m_isEnemy,m_pos,12.0,BulletType::Throw));
-                    }
-                }
-            }
-            else if(m_name==U"征")
-            {
-                if(500 < m_coolTime.ms())
-                {
-                    m_coolTime.restart();
-                    m_bullets.push_back(Bullet(m_isEnemy,m_pos,10.0,BulletType::Fall));
-                    if(2 <= m_grade)
-                    {
-                        m_bullets.push_back(Bullet(m_isEnemy,m_pos,10.0,BulletType::FallThrow));
-                    }
-                    if(3 <= m_grade)
-                    {
-                        m_bullets.push_back(Bullet(!m_isEnemy,m_pos,10.0,BulletType::FallThrow));
-                    }
-                }
-            }
-        
-            if(m_fallPos > m_pos.y)
-            {
-                m_pos.moveBy(m_speed, 10.0);
-            }
-            else
-            {
-                m_pos.moveBy(m_speed, 0);
-            }
-                
         }
         
-        for(auto& bullet : m_bullets)
-        {
-            bullet.update();
-        }
+        m_font(ch).drawAt(pos, color);
     }
     
-    const void draw()
-    {
-        if(m_isAlive)
-        {
-            switch (m_grade)
-            {
-                case 1:
-                    break;
-                
-                case 2:
-                    m_font(U"激").drawAt(m_pos-Vec2(0,100), m_isEnemy ? Palette::Blue : Palette::Red);
-                    break;
-                
-                case 3:
-                    m_font(U"超").drawAt(m_pos-Vec2(0,100), m_isEnemy ? Palette::Blue : Palette::Red);
-                    break;
-                
-                default:
-                    break;
-            }
-            
-            m_font(m_name).drawAt(m_pos, m_isEnemy ? Palette::Blue : Palette::Red);
-            
-        }
-        
-        for(auto& bullet : m_bullets)
-        {
-            bullet.draw();
-        }
-    }
 private:
-    const Font m_font;
-    const String m_name;
-    const bool m_isEnemy;
-    const int32 m_grade;
-    double m_speed;
-    Vec2 m_pos;
-    int32 m_hp;
-    bool m_isAlive;
-    Stopwatch m_coolTime;
-    Array<Bullet> m_bullets;
-    double m_fallPos;
+    Font m_font;
+    String m_chars;
+    Array<Glyph> m_glyphs;
 };
 
-struct Default : IEffect
+void DrawBullets(BulletStore& bullets, RenderBatch& batch)
 {
-    struct Particle
+    for(auto& lane : bullets.getLanes())
     {
-        Vec2 pos, v0;
-    };
-    
-    Array<Particle> m_particles;
-    
-    Default(const Vec2& pos, int count)
-    : m_particles(count)
-    {
-        int i=0;
-        for (auto& particle : m_particles)
+        for (auto i : step(lane.size()))
         {
-            const Vec2 v = Circular(10, 360_deg/count*i);
-            particle.pos = pos + Vec2(0,-50) + v;
-            particle.v0 = v * 20.0;
-            ++i;
+            if(lane.alive[i]) batch.addQuad(RectF(bullets.position(lane, i)-Vec2(20,20),40,40).rotated(bullets.now()*1.0_deg), lane.isEnemy[i] ? Palette::Blue : Palette::Red);
         }
     }
-    
-    bool update(double t) override
-    {
-        for (const auto& particle : m_particles)
-        {
-            const Vec2 pos = particle.pos + particle.v0 * t + 0.5* t*t * Vec2(0, 640);
-            
-            Circle(pos,10).draw(ColorF(HSV(360*t),1.0 - t));
-        }
-        
-        return t < 1.0;
-    }
-};
+}
 
-struct Fall : IEffect
+// without glyphs, as in headless rendering, a unit is drawn as its collision circle
+void DrawUnit(Player& unit, const UnitGlyphs* glyphs, RenderBatch& batch)
 {
-    struct Particle
-    {
-        Vec2 pos, v0;
-    };
-    
-    Array<Particle> m_particles;
-    Color m_color;
-    
-    Fall(const Vec2& pos, int count, Color color)
-    : m_particles(count)
-    , m_color(color)
+    if(unit.alive())
     {
-        int i=0;
-        for (auto& particle : m_particles)
+        const Color color = unit.isEnemy() ? Palette::Blue : Palette::Red;
+        
+        if(!glyphs)
         {
-            const Vec2 v = Circular(10, 360_deg/count*i);
-            particle.pos = pos + Vec2(0,0) + v;
-            particle.v0 = v * 10.0;
-            ++i;
+            batch.addCircle(unit.getPos(), 30, ColorF(color, 0.5*unit.getGrade()/3.0+0.25));
+            return;
         }
-    }
-    
-    bool update(double t) override
-    {
-        for (const auto& particle : m_particles)
+        
+        switch (unit.getGrade())
         {
-            const Vec2 pos = particle.pos + particle.v0 * t + 0.5* t*t * Vec2(0, 0);
-            
-            RectF(pos,30,30).rotated(t*360_deg).draw(ColorF(m_color,1.0 - t));
+            case 1:
+                break;
+                
+            case 2:
+                glyphs->drawAt(batch, U'激', unit.getPos()-Vec2(0,100), color);
+                break;
+                
+            case 3:
+                glyphs->drawAt(batch, U'超', unit.getPos()-Vec2(0,100), color);
+                break;
+                
+            default:
+                break;
         }
         
-        return t < 1.0;
+        glyphs->drawAt(batch, GetArchetype(unit.getKind()).glyph, unit.getPos(), color);
     }
-};
+}
 
-template <class ShapeType>
-class HighlightingShape : public ShapeType
+void Main()
 {
-private:
-    
-    Transition m_transition = Transition(0.2s, 0.1s);
-    
-public:
-    
-    HighlightingShape() = default;
-    
-    explicit HighlightingShape(const ShapeType& shape)
-    : ShapeType(shape) {}
-    
-    template <class ...Args>
-    explicit HighlightingShape(Args&&... args)
-    : ShapeType(std::forward<Args>(args)...) {}
-    
-    void update()
-    {
-        m_transition.update(ShapeType::mouseOver());
-    }
-    
-    void drawHighlight(Color color) const
+# ifdef GAMEJAM_LOAD_TEST
+    // a load test build never opens the game, it runs the headless scenarios and exits
+    const size_t failures = RunLoadTests([](Simulation& sim, RenderBatch& batch)
     {
-        ShapeType::drawFrame(0, 10, color);
-        
-        ShapeType::draw(ColorF(color, m_transition.value() * 0.25));
-    }
-    
-    const bool shapeClicked()
-    {
-        return ShapeType::leftClicked();
-    }
+        for(auto& player : sim.getPlayers())
+        {
+            DrawUnit(player, nullptr, batch);
+        }
+        for(auto& enemy : sim.getEnemies())
+        {
+            DrawUnit(enemy, nullptr, batch);
+        }
+        DrawBullets(sim.getBullets(), batch);
+    });
     
-    const Transition& getTransition() const
+    // Main has no return value, a CI run sees the failed checks as the exit status instead
+    if(failures != 0)
     {
-        return m_transition;
+        std::exit(static_cast<int>(Min<size_t>(failures, 125)));
     }
-};
+    return;
+# endif
 
-void Main()
-{
-    Window::Resize(1280, 720);
-    Graphics::SetBackground(Palette::Whitesmoke);
+    StartupTimer startupTimer;
     
-    Stopwatch gameCount;
+    Window::Resize(LaneWidth, LaneHeight);
+    Graphics::SetBackground(Palette::Whitesmoke);
     
-    Effect effect;
-    bool isGameOver = false;
+    // waves.csv next to the executable overrides the built-in wave table
+    const WaveTable waves = WaveTable::Load(U"waves.csv").value_or(WaveTable::Default());
+    
+    std::random_device seedDevice;
+    Simulation sim((static_cast<uint64>(seedDevice()) << 32) | seedDevice(), waves);
+    SimInput input;
+    double accumulator = 0.0;
+    
+    // F6 cycles the game speed, 0 runs as many ticks as fit in UncappedBudget each frame;
+    // only the newest state is drawn, the ticks in between are skipped
+    constexpr std::array<int32, 4> GameSpeeds = { 1, 2, 8, 0 };
+    constexpr auto UncappedBudget = std::chrono::milliseconds(12);
+    size_t speedIndex = 0;
+    
+    // ticks per second of wall time, measured over one second
+    double meterStart = 0.0;
+    int32 meterTick = 0;
+    double ticksPerSecond = 0.0;
+    
+    InputRecorder recorder;
+    recorder.reset(sim.getSeed());
+    bool isReplaySaved = false;
+    
+    // false once the match no longer follows from the seed and the input log, for the rest of the match
+    bool isReplayValid = true;
+    RewindBuffer rewind;
+    Array<uint8> saveState;
+    Optional<ReplayResult> replayResult;
+    
+    // V on the title plays versus against a scripted client over a loopback link, 100 ms away with a 2 tick input delay
+    Optional<LoopbackMatch> versus;
+    size_t rivalNext = 0;
+    
+    RenderBatch batch;
+    ParticlePool particles(8192);
+    bool showBatchStats = false;
+    FrameArena frameArena(256*1024);
+    uint64 gameplayAllocations = 0;
+    PhaseProfiler profiler;
+    bool showProfiler = false;
+    sim.setProfiler(&profiler);
+    JobSystem jobs;
+    sim.setJobSystem(&jobs);
     bool isStart = false;
     
     const Font UIFont(40,Typeface::Bold);
     const Font font(80,Typeface::Bold);
     const Font bigFont(250,Typeface::Bold);
     const Font powerUpFont(60,Typeface::Bold);
+    const Font debugFont(16);
+    StaticLayer hudLayer(Window::Size());
+    CachedText scoreText(UIFont);
+    CachedText energyText(UIFont);
+    Optional<UnitGlyphs> unitGlyphs;
     Array<HighlightingShape<Rect>> items;
-    Array<String> itemNames = {U"撃",U"打",U"伐",U"射",U"征"};
-    Array<int32> itemEnergies = {200,200,500,500,1000};
-    Array<int32> itemNumber = {0,0,0,0,0};
-    const int32 itemCount = 5;
+    Array<String> itemNames;
+    Array<int32> itemEnergies;
+    const int32 itemCount = Simulation::ItemCount;
     const Vec2 itemRange(100,50);
     const Vec2 itemSize((Window::Size().x)/itemCount-itemRange.x, Window::Size().y/5);
     
-    Stopwatch coolTime;
-    int32 nextCoolTime = 0;
-    Array<Player> players;
-    Stopwatch respawnTime;
-    Array<Player> enemies;
-    
-    int32 score = 0;
-    int32 energy = 2500;
-    const int32 maxEnergy = 100000;
-    int32 deadCount = 0;
-    const int32 maxDeadCount = 5;
-    
-    Audio bgm(U"example/bgm_maoudamashii_8bit25.mp3", Arg::loop_<bool>(true));
-    Audio selectSE(U"example/Pickup_Coin62.wav");
-    Audio cancelSE(U"example/Laser_Shoot58.wav");
-    Audio deadSE(U"example/Explosion69.wav");
-    Audio damageSE(U"example/Explosion72.wav");
-    Audio deathSE(U"example/Explosion78.wav");
-    Audio powerUpSE(U"example/Explosion31.wav");
+    Audio bgm;
+    Audio selectSE;
+    Audio cancelSE;
+    Audio deadSE;
+    Audio damageSE;
+    Audio deathSE;
+    Audio powerUpSE;
+    
+    // the title screen only needs the HUD fonts, everything else finishes loading behind it
+    AssetLoader loader;
+    loader.addSound(bgm, U"example/bgm_maoudamashii_8bit25.mp3", true);
+    loader.addSound(selectSE, U"example/Pickup_Coin62.wav");
+    loader.addSound(cancelSE, U"example/Laser_Shoot58.wav");
+    loader.addSound(deadSE, U"example/Explosion69.wav");
+    loader.addSound(damageSE, U"example/Explosion72.wav");
+    loader.addSound(deathSE, U"example/Explosion78.wav");
+    loader.addSound(powerUpSE, U"example/Explosion31.wav");
+    loader.addMainThreadTask([&]{ unitGlyphs.emplace(); });
+    loader.start();
+    
+    EventMixer mixer;
+    mixer.setSound(SoundCue::Select, selectSE);
+    mixer.setSound(SoundCue::Cancel, cancelSE);
+    mixer.setSound(SoundCue::PowerUp, powerUpSE);
+    mixer.setSound(SoundCue::Damage, damageSE);
+    mixer.setSound(SoundCue::Dead, deadSE);
+    
+    for(const auto& archetype : UnitArchetypes)
+    {
+        itemNames << String(1, archetype.glyph);
+        itemEnergies << archetype.cost;
+    }
     
     for (auto i : step(itemCount))
     {
@@ -430,338 +295,343 @@ void Main()
     
     while (System::Update())
     {
-        if(!isStart && MouseL.down())
-        {
-            coolTime.start();
-            gameCount.start();
-            respawnTime.start();
-            
-            selectSE.playOneShot();
-            bgm.play();
-            isStart = true;
-        }
+        profiler.beginFrame();
+        const uint64 frameAllocations = HeapStats::ThreadAllocations();
         
-        
-        if(isStart && energy < maxEnergy)
+        // the previous frame has been presented once Update returns again,
+        // loading only starts eating into frames after the title is on screen
+        if(1 < Scene::FrameCount())
         {
-            energy += (1+itemNumber.sum()/(itemCount*2));
+            startupTimer.markFirstFrame();
+            
+            loader.update(4.0);
+            if(loader.isReady())
+            {
+                startupTimer.markInteractive();
+            }
         }
         
-        if(!isGameOver && nextCoolTime < respawnTime.s())
         {
-            respawnTime.restart();
+            ScopedPhase phase(&profiler, FramePhase::Input);
             
-            if(gameCount.s() < 75)
+            if(!isStart && loader.isReady() && KeyV.down())
             {
-                nextCoolTime = Random(1,4);
-            }
-            else
-            {
-                nextCoolTime = 1;
+                sim = Simulation(sim.getSeed(), waves, SimMode::Versus);
+                sim.setProfiler(&profiler);
+                sim.setJobSystem(&jobs);
+                versus.emplace(sim, waves, 6, 2);
+                
+                // neither replays nor rewinding know about the other side's inputs
+                isReplayValid = false;
             }
             
-            int32 grade = 1;
-            
-            if(45 < gameCount.s())
+            if(!isStart && loader.isReady() && (MouseL.down() || versus))
             {
-                grade = 2;
+                selectSE.playOneShot();
+                bgm.play();
+                isStart = true;
             }
             
-            if(90 < gameCount.s())
+            for (auto& i : step(items.size()))
             {
-                grade = 3;
+                items[i].update();
+                if(isStart && !sim.isGameOver() && items[i].shapeClicked())
+                {
+                    input.item = i;
+                }
             }
             
-            int32 n = Random(0,100);
-            if(n < 40)
-            {
-                enemies.push_back(Player(itemNames[0],grade,true,Vec2(Window::Size().x+50,Window::Size().y/2+100)));
-            }
-            else if(n < 60)
-            {
-                enemies.push_back(Player(itemNames[1],grade,true,Vec2(Window::Size().x+50,Window::Size().y/2+100)));
-            }
-            else if(n < 80)
-            {
-                enemies.push_back(Player(itemNames[2],grade,true,Vec2(Window::Size().x+50,Window::Size().y/2+100)));
-            }
-            else if(n < 90)
-            {
-                enemies.push_back(Player(itemNames[3],grade,true,Vec2(Window::Size().x+50,Window::Size().y/2+100)));
-            }
-            else
+            if(Rect(0,200,100,Window::Size().y-450).leftClicked())
             {
-                enemies.push_back(Player(itemNames[4],grade,true,Vec2(Window::Size().x+50,Window::Size().y/2+100)));
+                input.bomb = true;
             }
-            
         }
         
-        for (auto& i : step(items.size()))
+        // versus runs at the other side's pace
+        if(isStart && !versus && KeyF6.down())
         {
-            items[i].update();
-            if(!isGameOver && items[i].shapeClicked())
+            speedIndex = (speedIndex+1) % GameSpeeds.size();
+            accumulator = 0.0;
+        }
+        
+        // fixed-timestep simulation, input is held until a tick consumes it
+        if(isStart)
+        {
+            const int32 speed = GameSpeeds[speedIndex];
+            const bool isUncapped = (speed == 0);
+            if(!isUncapped)
             {
-                if(itemNumber[i]<10)
-                {
-                    if(itemEnergies[i] < energy && 500 < coolTime.ms())
-                    {
-                        ++itemNumber[i];
-                        if(itemNumber[i]==10 || itemNumber[i]==25)
-                        {
-                            powerUpSE.playOneShot();
-                        }
-                        selectSE.playOneShot();
-                        coolTime.restart();
-                        energy -= itemEnergies[i];
-                        players.push_back(Player(itemNames[i],1,false,Vec2(-50,Window::Size().y/2+100)));
-                    }
-                    else
-                    {
-                        cancelSE.playOneShot();
-                    }
-                }
-                else if(itemNumber[i]<25)
+                accumulator = Min(accumulator + Scene::DeltaTime()*speed, 0.25*speed);
+            }
+            
+            const auto frameStart = std::chrono::steady_clock::now();
+            while(isUncapped ? (!sim.isGameOver() && std::chrono::steady_clock::now() - frameStart < UncappedBudget) : TickDuration <= accumulator)
+            {
+                if(versus)
                 {
-                    if(itemEnergies[i]*2 < energy && 1000 < coolTime.ms())
+                    // a tick spent waiting for the other side keeps the clicks for the next one
+                    if(versus->advance(input, [&](const Simulation& rivalSim){ return LoadTest::Decide(AutoPolicy::Mixed, rivalSim, rivalNext, true); }))
                     {
-                        ++itemNumber[i];
-                        selectSE.playOneShot();
-                        coolTime.restart();
-                        energy -= itemEnergies[i]*2;
-                        players.push_back(Player(itemNames[i],2,false,Vec2(-50,Window::Size().y/2+100)));
-                    }
-                    else
-                    {
-                        cancelSE.playOneShot();
+                        input = SimInput();
                     }
                 }
                 else
                 {
-                    if(itemEnergies[i]*3 < energy && 1000 < coolTime.ms())
-                    {
-                        ++itemNumber[i];
-                        selectSE.playOneShot();
-                        coolTime.restart();
-                        energy -= itemEnergies[i]*3;
-                        players.push_back(Player(itemNames[i],3,false,Vec2(-50,Window::Size().y/2+100)));
-                    }
-                    else
-                    {
-                        cancelSE.playOneShot();
-                    }
+                    recorder.record(sim.getTick()+1, input);
+                    sim.step(input);
+                    rewind.capture(sim);
+                    input = SimInput();
                 }
+                accumulator = Max(accumulator - TickDuration, 0.0);
             }
         }
         
-        for(auto& player : players)
+        if(1.0 <= Scene::Time() - meterStart)
         {
-            for(auto& enemy : enemies)
+            // a rewind or a loaded state moves the tick back, that second reads as zero
+            ticksPerSecond = Max(sim.getTick() - meterTick, 0) / (Scene::Time() - meterStart);
+            meterStart = Scene::Time();
+            meterTick = sim.getTick();
+        }
+        
+        // Backspace steps back half a second, F5/F9 save and load savestate.bin
+        if(isStart && !versus && KeyBackspace.down() && rewind.rewind(sim))
+        {
+            recorder.truncate(sim.getTick());
+            isReplaySaved = false;
+            accumulator = 0.0;
+            if(!sim.isGameOver() && !bgm.isPlaying())
             {
-                if(Circle(player.getPos(),30).intersects(Circle(enemy.getPos(),30)))
+                bgm.play();
+            }
+        }
+        
+        if(isStart && !versus && KeyF5.down())
+        {
+            sim.saveSnapshot(saveState);
+            BinaryWriter writer(U"savestate.bin");
+            writer.write(saveState.data(), saveState.size());
+        }
+        
+        if(isStart && !versus && KeyF9.down())
+        {
+            BinaryReader reader(U"savestate.bin");
+            Array<uint8> loaded(static_cast<size_t>(reader ? reader.size() : 0));
+            if(reader && reader.read(loaded.data(), loaded.size()) == reader.size())
+            {
+                // a bad file leaves the match where it was
+                sim.saveSnapshot(saveState);
+                if(sim.loadSnapshot(loaded))
                 {
-                    if(player.alive() && enemy.alive())
-                    {
-                        effect.add<Default>(Vec2((player.getPos().x+enemy.getPos().x)/2,player.getPos().y),10);
-                        
-                        if(player.nockBack(5*enemy.getGrade()))
-                        {
-                            effect.add<Fall>(player.getPos(), 10, Palette::Red);
-                            deadSE.playOneShot();
-                        }
-                        if(enemy.nockBack(5*player.getGrade()))
-                        {
-                            effect.add<Fall>(enemy.getPos(), 10, Palette::Blue);
-                            deadSE.playOneShot();
-                            score += 100;
-                        }
-                        else
-                        {
-                            damageSE.playOneShot();
-                        }
-
-                    }
+                    // a loaded state has no input log behind it, so this match is not saved as a replay
+                    rewind.clear();
+                    isReplayValid = false;
+                    accumulator = 0.0;
                 }
-                
-                for(auto& pBullet : player.getBullets())
-                {
-                    if(Circle(pBullet.getPos(),20).intersects(Circle(enemy.getPos(),30)))
-                    {
-                        if(pBullet.alive() && enemy.alive())
-                        {
-                            effect.add<Default>(Vec2((pBullet.getPos().x+enemy.getPos().x)/2,enemy.getPos().y),6);
-                            pBullet.dead();
-                            
-                            if(enemy.nockBack(2))
-                            {
-                                effect.add<Fall>(enemy.getPos(), 10, Palette::Blue);
-                                deadSE.playOneShot();
-                                score += 100;
-                            }
-                            else
-                            {
-                                damageSE.playOneShot();
-                            }
-
-                        }
-                    }
-                }
-                
-                for(auto& eBullet : enemy.getBullets())
+                else
                 {
-                    if(Circle(eBullet.getPos(),20).intersects(Circle(player.getPos(),30)))
-                    {
-                        if(eBullet.alive() && player.alive())
-                        {
-                            effect.add<Default>(Vec2((eBullet.getPos().x+player.getPos().x)/2,player.getPos().y),6);
-                            eBullet.dead();
-                            
-                            if(player.nockBack(2))
-                            {
-                                effect.add<Fall>(player.getPos(), 10, Palette::Blue);
-                                deadSE.playOneShot();
-                            }
-                            else
-                            {
-                                damageSE.playOneShot();
-                            }
-                        }
-                    }
+                    sim.loadSnapshot(saveState);
                 }
             }
         }
         
-        for(auto& player : players)
+        if(sim.isGameOver() && isReplayValid && !isReplaySaved)
         {
-            player.update();
-            
-            if(player.alive() && Window::Size().x+100 < player.getPos().x)
+            recorder.save(U"replay.bin", sim);
+            isReplaySaved = true;
+        }
+        
+        // R on the title screen re-runs the last saved match headless and checks it ends in the same state
+        if(!isStart && KeyR.down())
+        {
+            if(const auto replay = InputRecorder::Load(U"replay.bin"))
             {
-                player.dead();
-                powerUpSE.playOneShot();
-                score += 1000;
+                replayResult = RunReplay(*replay, waves);
             }
+        }
+        
+        mixer.consume(sim.getEvents(), particles, frameArena, Scene::DeltaTime());
+        sim.clearEvents();
+        
+        //draw
+        {
+            ScopedPhase phase(&profiler, FramePhase::Draw);
             
-            for(auto& pBullet : player.getBullets())
+            if(unitGlyphs)
             {
-                if(pBullet.alive() && Window::Size().x+50 < pBullet.getPos().x)
+                for(auto& player : sim.getPlayers())
                 {
-                    pBullet.dead();
+                    DrawUnit(player, &*unitGlyphs, batch);
+                }
+                
+                for(auto& enemy : sim.getEnemies())
+                {
+                    DrawUnit(enemy, &*unitGlyphs, batch);
                 }
             }
+            batch.flush();
+            
+            DrawBullets(sim.getBullets(), batch);
+        }
+        
+        
+        {
+            ScopedPhase phase(&profiler, FramePhase::Effects);
+            particles.update(Scene::DeltaTime());
+            particles.draw(batch);
+            batch.endFrame();
         }
         
-        for(auto& enemy : enemies)
+        // input, simulation and effects only, the HUD below still formats strings every frame
+        gameplayAllocations = HeapStats::ThreadAllocations() - frameAllocations;
+        profiler.setCount(FrameCounter::HeapAllocs, static_cast<size_t>(gameplayAllocations));
+        
         {
-            enemy.update();
+            ScopedPhase phase(&profiler, FramePhase::Hud);
             
-            if(enemy.alive() && enemy.getPos().x < -100)
+            for (const auto& item : items)
             {
-                ++deadCount;
-                deadSE.playOneShot();
-                if(maxDeadCount <= deadCount)
-                {
-                    isGameOver = true;
-                }
-                enemy.dead();
+                item.drawFill(Palette::Gray);
             }
             
-            for(auto& eBullet : enemy.getBullets())
+            // card tiers, the mode and both dead counts are all the static layer depends on
+            const Array<int32>& itemNumber = sim.getItemNumber();
+            constexpr uint64 deadCounts = Simulation::MaxDeadCount+1;
+            uint64 hudKey = static_cast<uint64>(sim.getMode());
+            hudKey = hudKey*deadCounts + static_cast<uint64>(sim.getRival().deadCount);
+            hudKey = hudKey*deadCounts + static_cast<uint64>(sim.getDeadCount());
+            for (const auto& i : step(itemCount))
             {
-                if(eBullet.alive() && eBullet.getPos().x < -50)
-                {
-                    eBullet.dead();
-                }
+                hudKey = hudKey*3 + ((itemNumber[i]<10) ? 0 : (itemNumber[i]<25) ? 1 : 2);
             }
-        }
-
-        if(Rect(0,200,100,Window::Size().y-450).leftClicked() &&  5000 < score)
-        {
-            score -= 5000;
             
-            deadSE.playOneShot();
-            for(const auto& i : step(10))
+            hudLayer.draw(hudKey, [&]
             {
-                 effect.add<Default>(Vec2(200+i*150,Window::Size().y/2-200), 20);
-            }
+                for (const auto& item : items)
+                {
+                    item.drawOutline(Palette::Gray);
+                }
+                
+                for (const auto& i : step(itemCount))
+                {
+                    if(itemNumber[i]<10)
+                    {
+                        font(itemNames[i]).draw(itemRange.x+30+i*itemSize.x*1.5, Window::Size().y-itemSize.y,Palette::Gray);
+                        UIFont(itemEnergies[i]).draw(Arg::topRight(itemRange.x+150+i*itemSize.x*1.5, Window::Size().y-itemSize.y-itemRange.y),Palette::Gray);
+                    }
+                    else if(itemNumber[i]<25)
+                    {
+                        powerUpFont(U"激",itemNames[i]).draw(itemRange.x+i*itemSize.x*1.5, Window::Size().y-itemSize.y+20,Palette::Gray);
+                        UIFont(itemEnergies[i]*2).draw(Arg::topRight(itemRange.x+150+i*itemSize.x*1.5, Window::Size().y-itemSize.y-itemRange.y),Palette::Gray);
+                    }
+                    else
+                    {
+                        powerUpFont(U"超",itemNames[i]).draw(itemRange.x+i*itemSize.x*1.5, Window::Size().y-itemSize.y+20,Palette::Gray);
+                        UIFont(itemEnergies[i]*3).draw(Arg::topRight(itemRange.x+150+i*itemSize.x*1.5, Window::Size().y-itemSize.y-itemRange.y),Palette::Gray);
+                    }
+                }
+                bigFont(U"鬱").drawAt(0,Window::Size().y/2,Palette::Gray);
+                
+                UIFont(U"Score : ").draw(50,0,Palette::Gray);
+                UIFont(U"Energy : ").draw(50+Window::Size().x/2,0,Palette::Gray);
+                
+                for (const auto& i : step(Simulation::MaxDeadCount))
+                {
+                    if(i<sim.getDeadCount())
+                    {
+                        UIFont(U"鬱").draw(50+i*50,80,Palette::Blue);
+                    }
+                    else
+                    {
+                        UIFont(U"鬱").draw(50+i*50,80,ColorF(Palette::Gray,0.5));
+                    }
+                    
+                    // in versus the other side's count sits under its energy
+                    if(sim.getMode() == SimMode::Versus)
+                    {
+                        UIFont(U"鬱").draw(50+Window::Size().x/2+i*50,80,(i<sim.getRival().deadCount) ? ColorF(Palette::Red) : ColorF(Palette::Gray,0.5));
+                    }
+                }
+            });
+            
+            scoreText.setNumber(sim.getScore());
+            scoreText.drawTopRight(batch, Vec2(Window::Size().x/2-50, 0), Palette::Gray);
+            
+            energyText.setNumber(sim.getEnergy());
+            energyText.drawTopRight(batch, Vec2(Window::Size().x-50, 0), Palette::Gray);
+            batch.flush();
             
-            for(auto& enemy : enemies)
+            if(!isStart)
             {
-                for(auto& eBullet : enemy.getBullets())
+                if(loader.isReady())
                 {
-                    eBullet.dead();
+                    font(U"マウスクリックでスタート").drawAt(Window::Center(),Palette::Red);
+                    UIFont(U"Vキーで対戦").drawAt(Window::Center()+Vec2(0,-90),Palette::Red);
+                }
+                else
+                {
+                    RectF(Arg::center(Window::Center()), 400*loader.progress(), 10).draw(Palette::Red);
+                }
+                
+                if(replayResult)
+                {
+                    debugFont(U"replay : ", replayResult->ticks, U" ticks in ", replayResult->seconds, U" s  score ", replayResult->score, U"  dead ", replayResult->deadCount, replayResult->matched ? U"  match" : U"  MISMATCH").drawAt(Window::Center()+Vec2(0,80), Palette::Black);
                 }
-                enemy.dead();
             }
-        }
-        /*
-        auto rmvIter = std::remove_if(players.begin(),players.end(),[](Player& p){return 500.0<p.getPos().x;});
-        players.erase(rmvIter, players.end());
-        */
-        //draw
-        for(auto& player : players)
-        {
-            player.draw();
+            
+            if(sim.isGameOver())
+            {
+                bgm.stop();
+                const bool isWin = versus && Simulation::MaxDeadCount <= sim.getRival().deadCount;
+                font(isWin ? U"You Win" : U"GameOver").drawAt(Window::Center(),Palette::Red);
+            }
         }
         
-        for(auto& enemy : enemies)
+        if(GameSpeeds[speedIndex] != 1)
         {
-            enemy.draw();
+            const int32 speed = GameSpeeds[speedIndex];
+            debugFont(speed ? U"speed x{}"_fmt(speed) : String(U"speed uncapped"), U"  ", ticksPerSecond, U" ticks/s").draw(50, 120, Palette::Black);
         }
         
-        effect.update();
-        
-        for (const auto& item : items)
+        if(KeyF3.down())
         {
-            item.drawHighlight(Palette::Gray);
+            showBatchStats = !showBatchStats;
         }
         
-        for (const auto& i : step(itemCount))
+        if(showBatchStats)
         {
-            if(itemNumber[i]<10)
-            {
-                font(itemNames[i]).draw(itemRange.x+30+i*itemSize.x*1.5, Window::Size().y-itemSize.y,Palette::Gray);
-                UIFont(itemEnergies[i]).draw(Arg::topRight(itemRange.x+150+i*itemSize.x*1.5, Window::Size().y-itemSize.y-itemRange.y),Palette::Gray);
-            }
-            else if(itemNumber[i]<25)
-            {
-                powerUpFont(U"激",itemNames[i]).draw(itemRange.x+i*itemSize.x*1.5, Window::Size().y-itemSize.y+20,Palette::Gray);
-                UIFont(itemEnergies[i]*2).draw(Arg::topRight(itemRange.x+150+i*itemSize.x*1.5, Window::Size().y-itemSize.y-itemRange.y),Palette::Gray);
-            }
-            else
+            const RenderBatch::Stats& stats = batch.getLastStats();
+            debugFont(U"draw calls : ", stats.drawCalls, U"  vertices : ", stats.vertices, U"  shapes : ", stats.shapes).draw(50, 140, Palette::Black);
+            debugFont(U"events : ", mixer.lastEventCount(), U"  bursts : ", mixer.lastBurstCount()).draw(50, 160, Palette::Black);
+            debugFont(startupTimer.report()).draw(50, 180, Palette::Black);
+            debugFont(U"heap allocs : ", gameplayAllocations, U" gameplay  arena : ", frameArena.highWater(), U" / ", frameArena.capacity(), U" bytes").draw(50, 200, Palette::Black);
+            debugFont(U"hud rebuilds : ", hudLayer.rebuilds(), U"  text reshapes : ", scoreText.reshapes() + energyText.reshapes()).draw(50, 220, Palette::Black);
+            
+            if(versus)
             {
-                powerUpFont(U"超",itemNames[i]).draw(itemRange.x+i*itemSize.x*1.5, Window::Size().y-itemSize.y+20,Palette::Gray);
-                UIFont(itemEnergies[i]*3).draw(Arg::topRight(itemRange.x+150+i*itemSize.x*1.5, Window::Size().y-itemSize.y-itemRange.y),Palette::Gray);
+                const RollbackStats& rollback = versus->local().stats();
+                debugFont(U"rollback : ", rollback.lastRollbackMs, U" ms last  ", rollback.maxRollbackMs, U" ms max  ", rollback.rollbacks, U" rollbacks  ", rollback.resimulatedTicks, U" resimulated  ", rollback.stalls, U" stalls").draw(50, 240, Palette::Black);
             }
         }
-        bigFont(U"鬱").drawAt(0,Window::Size().y/2,Palette::Gray);
-        
-        UIFont(U"Score : ").draw(50,0,Palette::Gray);
-        UIFont(score).draw(Arg::topRight(Window::Size().x/2-50, 0),Palette::Gray);
-        
-        UIFont(U"Energy : ").draw(50+Window::Size().x/2,0,Palette::Gray);
-        UIFont(energy).draw(Arg::topRight(Window::Size().x-50, 0),Palette::Gray);
         
-        for (const auto& i : step(maxDeadCount))
+        // F1 shows phase percentiles, F2 dumps the window to CSV
+        if(KeyF1.down())
         {
-            if(i<deadCount)
-            {
-                UIFont(U"鬱").draw(50+i*50,80,Palette::Blue);
-            }
-            else
-            {
-                UIFont(U"鬱").draw(50+i*50,80,ColorF(Palette::Gray,0.5));
-            }
+            showProfiler = !showProfiler;
         }
         
-        if(!isStart)
+        if(KeyF2.down())
         {
-            font(U"マウスクリックでスタート").drawAt(Window::Center(),Palette::Red);
+            profiler.saveCSV(U"profile.csv");
         }
         
-        if(isGameOver)
+        if(showProfiler)
         {
-            bgm.stop();
-            font(U"GameOver").drawAt(Window::Center(),Palette::Red);
+            profiler.drawOverlay(debugFont, Vec2(Window::Size().x-440, 60));
         }
+        
+        profiler.setCount(FrameCounter::Particles, particles.size());
+        profiler.endFrame();
+        frameArena.reset();
     }
 }
@@ -0,0 +1,331 @@
+# pragma once
+# include <Siv3D.hpp>
+# include <deque>
+# include "Simulation.hpp"
+
+// one side's clicks for one tick, the only thing that goes over the wire
+struct NetInput
+{
+    int32 tick = 0;
+    int8 item = -1;
+    uint8 bomb = 0;
+    uint8 padding[2] = {};
+};
+static_assert(sizeof(NetInput) == 8);
+
+inline NetInput ToNetInput(int32 tick, const SimInput& input)
+{
+    NetInput net;
+    net.tick = tick;
+    net.item = static_cast<int8>(input.item ? *input.item : -1);
+    net.bomb = input.bomb;
+    return net;
+}
+
+inline SimInput ToSimInput(const NetInput& net)
+{
+    SimInput input;
+    
+    // the other end is not trusted with an index into the shop
+    if(0 <= net.item && net.item < Simulation::ItemCount)
+    {
+        input.item = static_cast<size_t>(net.item);
+    }
+    input.bomb = (net.bomb != 0);
+    return input;
+}
+
+// two ends in one process, a packet arrives latency ticks of the link clock after it was sent;
+// packets are never lost or reordered, like the UDP path would be once acks and resends are on top
+class LoopbackLink
+{
+public:
+    explicit LoopbackLink(int32 latency = 0)
+    : m_latency(latency)
+    {}
+    
+    // side 0 sends to side 1 and the other way round
+    void send(size_t side, const NetInput& input)
+    {
+        m_queues[1-side].push_back(Packet{m_now + m_latency, input});
+    }
+    
+    Optional<NetInput> receive(size_t side)
+    {
+        auto& queue = m_queues[side];
+        if(queue.empty() || m_now < queue.front().deliverAt)
+        {
+            return none;
+        }
+        
+        const NetInput input = queue.front().input;
+        queue.pop_front();
+        return input;
+    }
+    
+    // call once per tick of the faster side
+    void tick()
+    {
+        ++m_now;
+    }
+    
+private:
+    struct Packet
+    {
+        int32 deliverAt;
+        NetInput input;
+    };
+    
+    std::array<std::deque<Packet>, 2> m_queues;
+    int32 m_latency;
+    int32 m_now = 0;
+};
+
+struct RollbackStats
+{
+    size_t ticks = 0;
+    size_t rollbacks = 0;
+    size_t resimulatedTicks = 0;
+    size_t stalls = 0;
+    double lastRollbackMs = 0.0;
+    double maxRollbackMs = 0.0;
+    double totalRollbackMs = 0.0;
+    
+    // rollback time spread over every advanced tick
+    double meanMsPerTick() const
+    {
+        return ticks ? totalRollbackMs / ticks : 0.0;
+    }
+};
+
+// drives one side of a versus match: local clicks are scheduled inputDelay ticks ahead and sent, the
+// remote side is predicted to do nothing until its input arrives, and a wrong guess loads the snapshot
+// from before that tick and simulates forward again; past MaxRollback unconfirmed ticks it waits instead
+class RollbackSession
+{
+public:
+    static constexpr int32 MaxRollback = 8;
+    static constexpr int32 MaxInputDelay = 30;
+    
+    // both ends compare a state hash this often, once the tick is confirmed
+    static constexpr int32 ChecksumInterval = TickRate;
+    
+    // side 0 plays the player team, side 1 the enemy team
+    RollbackSession(Simulation& sim, LoopbackLink& link, size_t side, int32 inputDelay)
+    : m_sim(sim)
+    , m_link(link)
+    , m_side(side)
+    , m_inputDelay(Clamp(inputDelay, 0, MaxInputDelay))
+    , m_localInputs(InputRingSize)
+    , m_remoteInputs(InputRingSize)
+    , m_snapshots(SnapshotCount)
+    {
+        // nobody can click for the first inputDelay ticks, so those are known on both ends
+        for (int32 tick = 0; tick <= m_inputDelay; ++tick)
+        {
+            m_localInputs[tick % InputRingSize].tick = tick;
+            m_remoteInputs[tick % InputRingSize].tick = tick;
+        }
+        m_remoteTick = m_inputDelay;
+    }
+    
+    // one fixed tick with this frame's local clicks; false when it had to wait for the remote side,
+    // the caller keeps the clicks for the next call then
+    bool advance(const SimInput& local)
+    {
+        receive();
+        
+        if(m_rollbackFrom)
+        {
+            rollback(*m_rollbackFrom);
+            m_rollbackFrom.reset();
+        }
+        confirm();
+        
+        const int32 next = m_sim.getTick()+1;
+        if(MaxRollback < next - m_remoteTick)
+        {
+            ++m_stats.stalls;
+            return false;
+        }
+        
+        const NetInput sent = ToNetInput(next + m_inputDelay, local);
+        m_localInputs[sent.tick % InputRingSize] = sent;
+        m_link.send(m_side, sent);
+        
+        simulate(next);
+        confirm();
+        ++m_stats.ticks;
+        return true;
+    }
+    
+    const RollbackStats& stats() const
+    {
+        return m_stats;
+    }
+    
+    // state hashes of confirmed ticks every ChecksumInterval, oldest first
+    const Array<std::pair<int32, uint64>>& checksums() const
+    {
+        return m_checksums;
+    }
+    
+    // the newest tick the remote input is known for
+    int32 remoteTick() const
+    {
+        return m_remoteTick;
+    }
+    
+private:
+    static constexpr int32 InputRingSize = 256;
+    static constexpr int32 SnapshotCount = MaxRollback+2;
+    
+    Simulation& m_sim;
+    LoopbackLink& m_link;
+    size_t m_side;
+    int32 m_inputDelay;
+    
+    Array<NetInput> m_localInputs;
+    Array<NetInput> m_remoteInputs;
+    int32 m_remoteTick = 0;
+    Optional<int32> m_rollbackFrom;
+    
+    // the state before tick t is kept at (t-1) % SnapshotCount
+    Array<Array<uint8>> m_snapshots;
+    
+    Optional<std::pair<int32, uint64>> m_pendingChecksum;
+    Array<std::pair<int32, uint64>> m_checksums;
+    RollbackStats m_stats;
+    
+    void receive()
+    {
+        while(const auto input = m_link.receive(m_side))
+        {
+            m_remoteInputs[input->tick % InputRingSize] = *input;
+            m_remoteTick = input->tick;
+            
+            // nothing was predicted, so only a click on an already simulated tick is a miss
+            if(input->tick <= m_sim.getTick() && (0 <= input->item || input->bomb))
+            {
+                m_rollbackFrom = Min(m_rollbackFrom.value_or(input->tick), input->tick);
+            }
+        }
+    }
+    
+    void rollback(int32 from)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const int32 last = m_sim.getTick();
+        
+        // the predicted ticks already sent their events, the corrected ones are not played twice
+        const size_t eventCount = m_sim.getEvents().size();
+        
+        m_sim.loadSnapshot(m_snapshots[(from-1) % SnapshotCount]);
+        for (int32 tick = from; tick <= last; ++tick)
+        {
+            simulate(tick);
+        }
+        m_sim.truncateEvents(eventCount);
+        
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        ++m_stats.rollbacks;
+        m_stats.resimulatedTicks += (last - from + 1);
+        m_stats.lastRollbackMs = ms;
+        m_stats.maxRollbackMs = Max(m_stats.maxRollbackMs, ms);
+        m_stats.totalRollbackMs += ms;
+    }
+    
+    void simulate(int32 tick)
+    {
+        m_sim.saveSnapshot(m_snapshots[(tick-1) % SnapshotCount]);
+        
+        const SimInput local = ToSimInput(inputAt(m_localInputs, tick, tick));
+        const SimInput remote = ToSimInput(inputAt(m_remoteInputs, tick, m_remoteTick));
+        
+        if(m_side == 0)
+        {
+            m_sim.step(local, remote);
+        }
+        else
+        {
+            m_sim.step(remote, local);
+        }
+        
+        if(tick % ChecksumInterval == 0)
+        {
+            m_pendingChecksum = std::make_pair(tick, m_sim.stateHash());
+        }
+    }
+    
+    // a tick after known, or one the ring no longer holds, is predicted as no click
+    static NetInput inputAt(const Array<NetInput>& inputs, int32 tick, int32 known)
+    {
+        const NetInput& input = inputs[tick % InputRingSize];
+        return (tick <= known && input.tick == tick) ? input : NetInput{tick};
+    }
+    
+    void confirm()
+    {
+        if(m_pendingChecksum && m_pendingChecksum->first <= m_remoteTick)
+        {
+            m_checksums.push_back(*m_pendingChecksum);
+            m_pendingChecksum.reset();
+        }
+    }
+};
+
+// a versus match where the other client runs in the same process: it keeps its own copy of the
+// match and the two only exchange inputs through the loopback link
+class LoopbackMatch
+{
+public:
+    LoopbackMatch(Simulation& local, const WaveTable& waves, int32 latency, int32 inputDelay)
+    : m_link(latency)
+    , m_rivalSim(local.getSeed(), waves, SimMode::Versus)
+    , m_local(local, m_link, 0, inputDelay)
+    , m_rival(m_rivalSim, m_link, 1, inputDelay)
+    {}
+    
+    // decideRival(const Simulation&) picks the other client's clicks from its own copy of the match
+    template <class Fty>
+    bool advance(const SimInput& local, Fty&& decideRival)
+    {
+        m_link.tick();
+        
+        if(!m_rivalInput)
+        {
+            m_rivalInput = decideRival(m_rivalSim);
+        }
+        if(m_rival.advance(*m_rivalInput))
+        {
+            m_rivalInput.reset();
+        }
+        
+        // nobody listens to the other client
+        m_rivalSim.clearEvents();
+        
+        return m_local.advance(local);
+    }
+    
+    const RollbackSession& local() const
+    {
+        return m_local;
+    }
+    
+    const RollbackSession& rival() const
+    {
+        return m_rival;
+    }
+    
+    const Simulation& rivalSim() const
+    {
+        return m_rivalSim;
+    }
+    
+private:
+    LoopbackLink m_link;
+    Simulation m_rivalSim;
+    RollbackSession m_local;
+    RollbackSession m_rival;
+    Optional<SimInput> m_rivalInput;
+};
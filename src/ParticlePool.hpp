@@ -0,0 +1,122 @@
+# pragma once
+# include <Siv3D.hpp>
+# include "RenderBatch.hpp"
+
+enum class ParticleShape : uint8
+{
+    Circle,
+    Square,
+};
+
+// how a burst is laid out, every particle then follows pos + v0*t + 0.5*t*t*gravity
+struct ParticleEmitter
+{
+    ParticleShape shape;
+    Vec2 offset;
+    double spread;
+    double speed;
+    Vec2 gravity;
+    double size;
+    bool rainbow;
+};
+
+namespace Emitters
+{
+    // colourful burst where units clash or a bullet lands
+    inline const ParticleEmitter Default{ParticleShape::Circle, Vec2(0,-50), 10.0, 20.0, Vec2(0,640), 10.0, true};
+    
+    // spinning squares in the team colour when a unit dies
+    inline const ParticleEmitter Fall{ParticleShape::Square, Vec2(0,0), 10.0, 10.0, Vec2(0,0), 30.0, false};
+}
+
+// fixed-capacity ring of particles, all with the same lifetime so the oldest always expires first
+class ParticlePool
+{
+public:
+    static constexpr double Lifetime = 1.0;
+    
+    explicit ParticlePool(size_t capacity)
+    : m_x(capacity)
+    , m_y(capacity)
+    , m_vx(capacity)
+    , m_vy(capacity)
+    , m_birth(capacity)
+    , m_color(capacity)
+    , m_emitter(capacity)
+    {}
+    
+    // when the pool is full the oldest particles are overwritten
+    void emit(const ParticleEmitter& emitter, const Vec2& pos, int32 count, const ColorF& color = Palette::White)
+    {
+        const size_t capacity = m_x.size();
+        
+        for (auto i : step(count))
+        {
+            const Vec2 v = Circular(emitter.spread, 360_deg/count*i);
+            const Vec2 p = pos + emitter.offset + v;
+            
+            m_x[m_head] = p.x;
+            m_y[m_head] = p.y;
+            m_vx[m_head] = v.x * emitter.speed;
+            m_vy[m_head] = v.y * emitter.speed;
+            m_birth[m_head] = m_time;
+            m_color[m_head] = color;
+            m_emitter[m_head] = &emitter;
+            
+            m_head = (m_head+1) % capacity;
+            m_count = Min(m_count+1, capacity);
+        }
+    }
+    
+    void update(double dt)
+    {
+        m_time += dt;
+        
+        const size_t capacity = m_x.size();
+        while(m_count != 0 && Lifetime <= m_time - m_birth[(m_head+capacity-m_count) % capacity])
+        {
+            --m_count;
+        }
+    }
+    
+    void draw(RenderBatch& batch) const
+    {
+        const size_t capacity = m_x.size();
+        
+        for (size_t n = 0; n < m_count; ++n)
+        {
+            const size_t i = (m_head+capacity-m_count+n) % capacity;
+            const ParticleEmitter& emitter = *m_emitter[i];
+            const double t = m_time - m_birth[i];
+            const Vec2 pos(m_x[i] + m_vx[i]*t + 0.5*t*t*emitter.gravity.x,
+                           m_y[i] + m_vy[i]*t + 0.5*t*t*emitter.gravity.y);
+            const ColorF color = emitter.rainbow ? ColorF(HSV(360*t), 1.0 - t) : ColorF(m_color[i], 1.0 - t);
+            
+            if(emitter.shape == ParticleShape::Circle)
+            {
+                batch.addCircle(pos, emitter.size, color);
+            }
+            else
+            {
+                batch.addQuad(RectF(pos, emitter.size, emitter.size).rotated(t*360_deg), color);
+            }
+        }
+    }
+    
+    size_t size() const
+    {
+        return m_count;
+    }
+    
+private:
+    Array<double> m_x;
+    Array<double> m_y;
+    Array<double> m_vx;
+    Array<double> m_vy;
+    Array<double> m_birth;
+    Array<ColorF> m_color;
+    Array<const ParticleEmitter*> m_emitter;
+    size_t m_head = 0;
+    size_t m_count = 0;
+    double m_time = 0.0;
+};
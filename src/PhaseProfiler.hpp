@@ -0,0 +1,218 @@
+# pragma once
+# include <Siv3D.hpp>
+
+enum class FramePhase : uint8
+{
+    Input,
+    Spawn,
+    Collision,
+    Update,
+    Despawn,
+    Bomb,
+    Draw,
+    Effects,
+    Hud,
+    Count,
+};
+
+enum class FrameCounter : uint8
+{
+    Players,
+    Enemies,
+    Bullets,
+    Particles,
+    DeadUnits,
+    DeadBullets,
+    HeapAllocs,
+    Count,
+};
+
+// per-phase frame times over a rolling window, plus entity counts for the same frames
+class PhaseProfiler
+{
+public:
+    static constexpr size_t PhaseCount = static_cast<size_t>(FramePhase::Count);
+    static constexpr size_t CounterCount = static_cast<size_t>(FrameCounter::Count);
+    static constexpr size_t History = 600;
+    
+    static constexpr std::array<StringView, PhaseCount> PhaseNames =
+    {
+        U"input", U"spawn", U"collision", U"update", U"despawn", U"bomb", U"draw", U"effects", U"hud",
+    };
+    
+    static constexpr std::array<StringView, CounterCount> CounterNames =
+    {
+        U"players", U"enemies", U"bullets", U"particles", U"deadUnits", U"deadBullets", U"heapAllocs",
+    };
+    
+    PhaseProfiler()
+    {
+        for(auto& history : m_times)
+        {
+            history.resize(History);
+        }
+        
+        for(auto& history : m_counts)
+        {
+            history.resize(History);
+        }
+    }
+    
+    void beginFrame()
+    {
+        m_frameTimes.fill(0.0);
+        m_frameCounts.fill(0);
+    }
+    
+    void addTime(FramePhase phase, double ms)
+    {
+        m_frameTimes[static_cast<size_t>(phase)] += ms;
+    }
+    
+    void setCount(FrameCounter counter, size_t value)
+    {
+        m_frameCounts[static_cast<size_t>(counter)] = value;
+    }
+    
+    void addCount(FrameCounter counter, size_t value)
+    {
+        m_frameCounts[static_cast<size_t>(counter)] += value;
+    }
+    
+    void endFrame()
+    {
+        for (auto i : step(PhaseCount))
+        {
+            m_times[i][m_head] = m_frameTimes[i];
+        }
+        
+        for (auto i : step(CounterCount))
+        {
+            m_counts[i][m_head] = m_frameCounts[i];
+        }
+        
+        m_head = (m_head+1) % History;
+        m_frames = Min(m_frames+1, History);
+    }
+    
+    // p in [0, 1], over the frames currently in the window
+    double percentile(FramePhase phase, double p) const
+    {
+        if(m_frames == 0)
+        {
+            return 0.0;
+        }
+        
+        m_scratch.assign(m_times[static_cast<size_t>(phase)].begin(), m_times[static_cast<size_t>(phase)].begin()+m_frames);
+        const size_t n = Min(static_cast<size_t>(p*m_frames), m_frames-1);
+        std::nth_element(m_scratch.begin(), m_scratch.begin()+n, m_scratch.end());
+        return m_scratch[n];
+    }
+    
+    double lastTime(FramePhase phase) const
+    {
+        return m_times[static_cast<size_t>(phase)][(m_head+History-1) % History];
+    }
+    
+    size_t lastCount(FrameCounter counter) const
+    {
+        return m_counts[static_cast<size_t>(counter)][(m_head+History-1) % History];
+    }
+    
+    void drawOverlay(const Font& font, const Vec2& pos) const
+    {
+        const RectF background(pos, 420, 20 + (PhaseCount+CounterCount+1)*font.height());
+        background.draw(ColorF(0.0, 0.6));
+        
+        Vec2 penPos = pos + Vec2(10,10);
+        font(U"phase        p50     p95     p99 (ms)").draw(penPos, Palette::White);
+        penPos.y += font.height();
+        
+        for (auto i : step(PhaseCount))
+        {
+            const FramePhase phase = static_cast<FramePhase>(i);
+            font(U"{:<10} {:>7.3f} {:>7.3f} {:>7.3f}"_fmt(PhaseNames[i], percentile(phase, 0.50), percentile(phase, 0.95), percentile(phase, 0.99))).draw(penPos, Palette::White);
+            penPos.y += font.height();
+        }
+        
+        for (auto i : step(CounterCount))
+        {
+            font(U"{:<10} {:>7}"_fmt(CounterNames[i], lastCount(static_cast<FrameCounter>(i)))).draw(penPos, Palette::White);
+            penPos.y += font.height();
+        }
+    }
+    
+    // one row per frame in the window, oldest first
+    bool saveCSV(const FilePath& path) const
+    {
+        TextWriter writer(path);
+        if(!writer)
+        {
+            return false;
+        }
+        
+        String header = U"frame";
+        for(const auto& name : PhaseNames)
+        {
+            header += U"," + name.toString() + U"_ms";
+        }
+        for(const auto& name : CounterNames)
+        {
+            header += U"," + name.toString();
+        }
+        writer.writeln(header);
+        
+        for (size_t n = 0; n < m_frames; ++n)
+        {
+            const size_t i = (m_head+History-m_frames+n) % History;
+            String row = Format(n);
+            for(const auto& history : m_times)
+            {
+                row += U"," + Format(history[i]);
+            }
+            for(const auto& history : m_counts)
+            {
+                row += U"," + Format(history[i]);
+            }
+            writer.writeln(row);
+        }
+        
+        return true;
+    }
+    
+private:
+    std::array<Array<double>, PhaseCount> m_times;
+    std::array<Array<size_t>, CounterCount> m_counts;
+    std::array<double, PhaseCount> m_frameTimes = {};
+    std::array<size_t, CounterCount> m_frameCounts = {};
+    size_t m_head = 0;
+    size_t m_frames = 0;
+    mutable Array<double> m_scratch;
+};
+
+// adds the time until the end of the scope to a phase, does nothing without a profiler
+class ScopedPhase
+{
+public:
+    ScopedPhase(PhaseProfiler* profiler, FramePhase phase)
+    : m_profiler(profiler)
+    , m_phase(phase)
+    , m_start(std::chrono::steady_clock::now())
+    {}
+    
+    ~ScopedPhase()
+    {
+        if(m_profiler)
+        {
+            m_profiler->addTime(m_phase, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count());
+        }
+    }
+    
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+    
+private:
+    PhaseProfiler* m_profiler;
+    FramePhase m_phase;
+    std::chrono::steady_clock::time_point m_start;
+};
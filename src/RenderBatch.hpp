@@ -0,0 +1,188 @@
+# pragma once
+# include <Siv3D.hpp>
+# include "SoftwareRaster.hpp"
+
+// collects one frame's bullets, glyphs and particles and submits them as a few vertex buffers
+class RenderBatch
+{
+public:
+    struct Stats
+    {
+        size_t drawCalls = 0;
+        size_t vertices = 0;
+        size_t shapes = 0;
+    };
+    
+    void addQuad(const Quad& quad, const ColorF& color)
+    {
+        Sprite& sprite = shapeSprite(4);
+        const uint16 base = static_cast<uint16>(sprite.vertices.size());
+        const Float4 c = color.toFloat4();
+        
+        sprite.vertices.push_back(Vertex2D{Float2(quad.p0), Float2(0,0), c});
+        sprite.vertices.push_back(Vertex2D{Float2(quad.p1), Float2(0,0), c});
+        sprite.vertices.push_back(Vertex2D{Float2(quad.p2), Float2(0,0), c});
+        sprite.vertices.push_back(Vertex2D{Float2(quad.p3), Float2(0,0), c});
+        pushQuadIndices(sprite, base);
+        ++m_current.shapes;
+    }
+    
+    void addCircle(const Vec2& center, double r, const ColorF& color)
+    {
+        Sprite& sprite = shapeSprite(CircleSegments+1);
+        const uint16 base = static_cast<uint16>(sprite.vertices.size());
+        const Float4 c = color.toFloat4();
+        
+        sprite.vertices.push_back(Vertex2D{Float2(center), Float2(0,0), c});
+        for (auto i : step(CircleSegments))
+        {
+            sprite.vertices.push_back(Vertex2D{Float2(center + Circular(r, 360_deg*i/CircleSegments)), Float2(0,0), c});
+        }
+        
+        for (auto i : step(CircleSegments))
+        {
+            sprite.indices.push_back(base);
+            sprite.indices.push_back(static_cast<uint16>(base+1+i));
+            sprite.indices.push_back(static_cast<uint16>(base+1+(i+1)%CircleSegments));
+        }
+        ++m_current.shapes;
+    }
+    
+    void addTexture(const TextureRegion& region, const Vec2& pos, const ColorF& color)
+    {
+        TextureGroup& group = textureGroup(region.texture);
+        Sprite& sprite = group.sprite;
+        const uint16 base = static_cast<uint16>(sprite.vertices.size());
+        const Float4 c = color.toFloat4();
+        const FloatRect& uv = region.uvRect;
+        
+        sprite.vertices.push_back(Vertex2D{Float2(pos), Float2(uv.left, uv.top), c});
+        sprite.vertices.push_back(Vertex2D{Float2(pos + Vec2(region.size.x, 0)), Float2(uv.right, uv.top), c});
+        sprite.vertices.push_back(Vertex2D{Float2(pos + region.size), Float2(uv.right, uv.bottom), c});
+        sprite.vertices.push_back(Vertex2D{Float2(pos + Vec2(0, region.size.y)), Float2(uv.left, uv.bottom), c});
+        pushQuadIndices(sprite, base);
+        ++m_current.shapes;
+    }
+    
+    // draws everything collected since the last flush, in shape then texture order
+    void flush()
+    {
+        for (auto i : step(m_usedShapeSprites))
+        {
+            submit(m_shapeSprites[i], none);
+        }
+        m_usedShapeSprites = 0;
+        
+        for(auto& group : m_textureGroups)
+        {
+            submit(group.sprite, group.texture);
+        }
+    }
+    
+    // closes the frame, the finished frame's numbers stay readable until the next one
+    void endFrame()
+    {
+        flush();
+        m_last = m_current;
+        m_current = Stats();
+    }
+    
+    const Stats& getLastStats() const
+    {
+        return m_last;
+    }
+    
+    // while set, submitted sprites go to the software rasteriser instead of the GPU
+    void setSoftwareTarget(SoftwareRaster* raster)
+    {
+        m_raster = raster;
+    }
+    
+private:
+    struct TextureGroup
+    {
+        Texture texture;
+        Sprite sprite;
+    };
+    
+    static constexpr int32 CircleSegments = 16;
+    
+    // Vertex2D indices are 16 bit, so a sprite is closed before it overflows
+    static constexpr size_t MaxVertices = 65535;
+    
+    Array<Sprite> m_shapeSprites;
+    size_t m_usedShapeSprites = 0;
+    Array<TextureGroup> m_textureGroups;
+    Stats m_current;
+    Stats m_last;
+    SoftwareRaster* m_raster = nullptr;
+    
+    Sprite& shapeSprite(size_t vertexCount)
+    {
+        if(m_usedShapeSprites == 0 || MaxVertices < m_shapeSprites[m_usedShapeSprites-1].vertices.size() + vertexCount)
+        {
+            if(m_shapeSprites.size() == m_usedShapeSprites)
+            {
+                m_shapeSprites.push_back(Sprite());
+            }
+            ++m_usedShapeSprites;
+        }
+        
+        return m_shapeSprites[m_usedShapeSprites-1];
+    }
+    
+    TextureGroup& textureGroup(const Texture& texture)
+    {
+        for(auto& group : m_textureGroups)
+        {
+            if(group.texture.id() == texture.id())
+            {
+                if(MaxVertices < group.sprite.vertices.size() + 4)
+                {
+                    submit(group.sprite, group.texture);
+                }
+                return group;
+            }
+        }
+        
+        m_textureGroups.push_back(TextureGroup{texture, Sprite()});
+        return m_textureGroups.back();
+    }
+    
+    static void pushQuadIndices(Sprite& sprite, uint16 base)
+    {
+        sprite.indices.push_back(base);
+        sprite.indices.push_back(static_cast<uint16>(base+1));
+        sprite.indices.push_back(static_cast<uint16>(base+2));
+        sprite.indices.push_back(base);
+        sprite.indices.push_back(static_cast<uint16>(base+2));
+        sprite.indices.push_back(static_cast<uint16>(base+3));
+    }
+    
+    // capacity is kept so a steady frame does not reallocate
+    void submit(Sprite& sprite, const Optional<Texture>& texture)
+    {
+        if(sprite.vertices.isEmpty())
+        {
+            return;
+        }
+        
+        if(m_raster)
+        {
+            m_raster->drawTriangles(sprite.vertices, sprite.indices, texture.has_value());
+        }
+        else if(texture)
+        {
+            sprite.draw(*texture);
+        }
+        else
+        {
+            sprite.draw();
+        }
+        
+        ++m_current.drawCalls;
+        m_current.vertices += sprite.vertices.size();
+        sprite.vertices.clear();
+        sprite.indices.clear();
+    }
+};
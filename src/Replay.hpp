@@ -0,0 +1,159 @@
+# pragma once
+# include <Siv3D.hpp>
+# include "Simulation.hpp"
+
+// one tick that had input, ticks without input are not stored
+struct ReplayEntry
+{
+    uint32 tick;
+    int8 item;
+    uint8 bomb;
+};
+
+struct ReplayData
+{
+    uint64 seed = 0;
+    uint32 tickCount = 0;
+    uint64 finalHash = 0;
+    Array<ReplayEntry> entries;
+};
+
+struct ReplayResult
+{
+    uint64 hash = 0;
+    int32 score = 0;
+    int32 deadCount = 0;
+    uint32 ticks = 0;
+    double seconds = 0.0;
+    bool matched = false;
+};
+
+class InputRecorder
+{
+public:
+    static constexpr uint32 Magic = 0x4C50524A; // "JRPL"
+    static constexpr uint32 Version = 4;
+    
+    void reset(uint64 seed)
+    {
+        m_data = ReplayData();
+        m_data.seed = seed;
+    }
+    
+    // call with the tick number the input is about to be stepped on
+    void record(int32 tick, const SimInput& input)
+    {
+        m_data.tickCount = static_cast<uint32>(tick);
+        
+        if(input.item || input.bomb)
+        {
+            m_data.entries.push_back(ReplayEntry{static_cast<uint32>(tick), static_cast<int8>(input.item ? *input.item : -1), input.bomb});
+        }
+    }
+    
+    // forgets everything after the given tick, for when the match is rewound
+    void truncate(int32 tick)
+    {
+        m_data.tickCount = static_cast<uint32>(tick);
+        m_data.entries.remove_if([tick](const ReplayEntry& entry){ return static_cast<int32>(entry.tick) > tick; });
+    }
+    
+    bool save(const FilePath& path, const Simulation& sim)
+    {
+        m_data.finalHash = sim.stateHash();
+        
+        BinaryWriter writer(path);
+        if(!writer)
+        {
+            return false;
+        }
+        
+        const uint32 entryCount = static_cast<uint32>(m_data.entries.size());
+        writer.write(Magic);
+        writer.write(Version);
+        writer.write(m_data.seed);
+        writer.write(m_data.tickCount);
+        writer.write(m_data.finalHash);
+        writer.write(entryCount);
+        if(entryCount)
+        {
+            writer.write(m_data.entries.data(), entryCount * sizeof(ReplayEntry));
+        }
+        return true;
+    }
+    
+    static Optional<ReplayData> Load(const FilePath& path)
+    {
+        BinaryReader reader(path);
+        if(!reader)
+        {
+            return none;
+        }
+        
+        uint32 magic = 0, version = 0, entryCount = 0;
+        ReplayData data;
+        if(!reader.read(magic) || magic != Magic || !reader.read(version) || version != Version)
+        {
+            return none;
+        }
+        
+        if(!reader.read(data.seed) || !reader.read(data.tickCount) || !reader.read(data.finalHash) || !reader.read(entryCount))
+        {
+            return none;
+        }
+        
+        data.entries.resize(entryCount);
+        if(entryCount && reader.read(data.entries.data(), entryCount * sizeof(ReplayEntry)) != static_cast<int64>(entryCount * sizeof(ReplayEntry)))
+        {
+            return none;
+        }
+        
+        // anything past the card row would index out of the shop
+        if(!data.entries.all([](const ReplayEntry& entry){ return entry.item < Simulation::ItemCount; }))
+        {
+            return none;
+        }
+        
+        return data;
+    }
+    
+private:
+    ReplayData m_data;
+};
+
+// drives a fresh simulation from the log as fast as it will go, with no window output;
+// the wave table is not stored, so it has to be the one the match was played with
+inline ReplayResult RunReplay(const ReplayData& data, const WaveTable& waves)
+{
+    Simulation sim(data.seed, waves);
+    size_t next = 0;
+    
+    const auto start = std::chrono::steady_clock::now();
+    
+    for (uint32 tick = 1; tick <= data.tickCount; ++tick)
+    {
+        SimInput input;
+        
+        while(next < data.entries.size() && data.entries[next].tick == tick)
+        {
+            if(0 <= data.entries[next].item)
+            {
+                input.item = static_cast<size_t>(data.entries[next].item);
+            }
+            input.bomb = input.bomb || data.entries[next].bomb;
+            ++next;
+        }
+        
+        sim.step(input);
+        sim.clearEvents();
+    }
+    
+    ReplayResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.hash = sim.stateHash();
+    result.score = sim.getScore();
+    result.deadCount = sim.getDeadCount();
+    result.ticks = data.tickCount;
+    result.matched = (result.hash == data.finalHash);
+    return result;
+}
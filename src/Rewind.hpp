@@ -0,0 +1,76 @@
+# pragma once
+# include <Siv3D.hpp>
+# include "Simulation.hpp"
+
+// the last few snapshots, one every interval ticks, so a match can be stepped back through
+class RewindBuffer
+{
+public:
+    explicit RewindBuffer(size_t capacity = 60, int32 interval = TickRate/2)
+    : m_slots(capacity)
+    , m_ticks(capacity)
+    , m_interval(interval)
+    {}
+    
+    // call after every step, only every interval-th tick is kept
+    void capture(const Simulation& sim)
+    {
+        if(sim.getTick() % m_interval != 0)
+        {
+            return;
+        }
+        
+        const size_t capacity = m_slots.size();
+        const size_t slot = (m_first+m_count) % capacity;
+        if(m_count == capacity)
+        {
+            m_first = (m_first+1) % capacity;
+        }
+        else
+        {
+            ++m_count;
+        }
+        
+        sim.saveSnapshot(m_slots[slot]);
+        m_ticks[slot] = sim.getTick();
+    }
+    
+    // goes back to the newest snapshot older than the current tick, which stays so the next call goes further back
+    bool rewind(Simulation& sim)
+    {
+        while(m_count != 0 && sim.getTick() <= m_ticks[newest()])
+        {
+            --m_count;
+        }
+        
+        if(m_count == 0)
+        {
+            return false;
+        }
+        
+        return sim.loadSnapshot(m_slots[newest()]);
+    }
+    
+    void clear()
+    {
+        m_first = 0;
+        m_count = 0;
+    }
+    
+    size_t size() const
+    {
+        return m_count;
+    }
+    
+private:
+    Array<Array<uint8>> m_slots;
+    Array<int32> m_ticks;
+    int32 m_interval;
+    size_t m_first = 0;
+    size_t m_count = 0;
+    
+    size_t newest() const
+    {
+        return (m_first+m_count-1) % m_slots.size();
+    }
+};
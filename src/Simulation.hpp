@@ -0,0 +1,2187 @@
+# pragma once
+# include <Siv3D.hpp>
+# include "PhaseProfiler.hpp"
+# include "JobSystem.hpp"
+# include "EventRing.hpp"
+# include "Snapshot.hpp"
+
+// the lane is simulated in its own coordinates so it can run without a window
+constexpr int32 LaneWidth = 1280;
+constexpr int32 LaneHeight = 720;
+
+constexpr int32 TickRate = 60;
+constexpr double TickDuration = 1.0 / TickRate;
+
+constexpr int32 MillisecToTicks(int32 ms)
+{
+    return ms * TickRate / 1000;
+}
+
+// splitmix64, so a seed gives the same match on every platform and standard library
+class SimRandom
+{
+public:
+    explicit SimRandom(uint64 seed = 0)
+    : m_state(seed)
+    {}
+    
+    uint64 next()
+    {
+        uint64 z = (m_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    
+    // inclusive on both ends like s3d::Random
+    int32 range(int32 min, int32 max)
+    {
+        return min + static_cast<int32>(next() % static_cast<uint64>(max - min + 1));
+    }
+    
+private:
+    uint64 m_state;
+};
+
+// FNV-1a over the raw bytes of the match state, used to compare runs bit for bit
+class StateHash
+{
+public:
+    void add(const void* data, size_t size)
+    {
+        const uint8* bytes = static_cast<const uint8*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            m_value = (m_value ^ bytes[i]) * 0x100000001B3ull;
+        }
+    }
+    
+    template <class Type>
+    void add(const Type& value)
+    {
+        static_assert(std::is_trivially_copyable_v<Type>);
+        add(&value, sizeof(Type));
+    }
+    
+    template <class Type>
+    void add(const Array<Type>& values)
+    {
+        add(values.size());
+        if(!values.isEmpty())
+        {
+            add(values.data(), values.size() * sizeof(Type));
+        }
+    }
+    
+    uint64 value() const
+    {
+        return m_value;
+    }
+    
+private:
+    uint64 m_value = 0xCBF29CE484222325ull;
+};
+
+// the circle r around the segment a-b against a point, the swept form of a circle-circle test
+inline bool CapsuleHit(const Vec2& a, const Vec2& b, const Vec2& center, double r)
+{
+    const Vec2 ab = b - a;
+    const double lengthSq = ab.lengthSq();
+    const double t = (0.0 < lengthSq) ? Clamp((center - a).dot(ab) / lengthSq, 0.0, 1.0) : 0.0;
+    return (a + ab*t).distanceFromSq(center) <= r*r;
+}
+
+enum class BulletType
+{
+    Normal,
+    Throw,
+    Fall,
+    FallThrow,
+};
+
+// all bullets in struct-of-arrays form, one lane per BulletType; a bullet only stores where and when it was
+// fired, its position is a closed-form function of its age and its expiry tick is worked out at spawn
+class BulletStore
+{
+public:
+    struct Lane
+    {
+        // Throw arcs up from -12 per tick and falls back with 0.2 per tick squared
+        bool isThrow = false;
+        
+        Array<int32> birth;
+        Array<double> x0;
+        Array<double> y0;
+        Array<double> vx;
+        Array<double> vy;
+        Array<uint32> generation;
+        Array<uint8> isEnemy;
+        Array<uint8> isEnemyTeam;
+        Array<uint8> alive;
+        
+        // slots, including free ones
+        size_t size() const
+        {
+            return birth.size();
+        }
+        
+        Vec2 at(size_t i, int32 now) const
+        {
+            const double k = now - birth[i];
+            const double drop = isThrow ? (-12.0*k + 0.1*k*(k-1)) : 0.0;
+            return Vec2(x0[i] + vx[i]*k, y0[i] + vy[i]*k + drop);
+        }
+    };
+    
+    static constexpr size_t LaneCount = 4;
+    
+    BulletStore()
+    {
+        m_lanes[static_cast<size_t>(BulletType::Throw)].isThrow = true;
+    }
+    
+    // isEnemy picks direction and colour, isEnemyTeam picks who the bullet can hit
+    void spawn(BulletType type, bool isEnemy, bool isEnemyTeam, const Vec2& pos, double speed)
+    {
+        const size_t laneIndex = static_cast<size_t>(type);
+        Lane& lane = m_lanes[laneIndex];
+        const double dir = isEnemy ? -1.0 : 1.0;
+        
+        Vec2 v;
+        switch (type)
+        {
+            case BulletType::Fall:
+                v = Vec2(0.0, speed);
+                break;
+            case BulletType::FallThrow:
+                v = Vec2(dir*speed/2, speed);
+                break;
+            default:
+                v = Vec2(dir*speed, 0.0);
+                break;
+        }
+        
+        size_t i;
+        if(m_free[laneIndex].isEmpty())
+        {
+            i = lane.size();
+            lane.birth.push_back(0);
+            lane.x0.push_back(0.0);
+            lane.y0.push_back(0.0);
+            lane.vx.push_back(0.0);
+            lane.vy.push_back(0.0);
+            lane.generation.push_back(0);
+            lane.isEnemy.push_back(false);
+            lane.isEnemyTeam.push_back(false);
+            lane.alive.push_back(false);
+        }
+        else
+        {
+            i = m_free[laneIndex].back();
+            m_free[laneIndex].pop_back();
+        }
+        
+        lane.birth[i] = m_now;
+        lane.x0[i] = pos.x;
+        lane.y0[i] = pos.y;
+        lane.vx[i] = v.x;
+        lane.vy[i] = v.y;
+        lane.isEnemy[i] = isEnemy;
+        lane.isEnemyTeam[i] = isEnemyTeam;
+        lane.alive[i] = true;
+        ++m_live[laneIndex];
+        
+        pushExpiry(Expiry{m_now + lifetime(lane, i), static_cast<uint32>(i), lane.generation[i], static_cast<uint8>(laneIndex)});
+    }
+    
+    // bullets move by themselves, a tick only advances the clock they are evaluated against
+    void update()
+    {
+        ++m_now;
+    }
+    
+    int32 now() const
+    {
+        return m_now;
+    }
+    
+    Vec2 position(const Lane& lane, size_t i) const
+    {
+        return lane.at(i, m_now);
+    }
+    
+    // whether the path from tick from to now, no earlier than the bullet's birth, passes within r of center;
+    // straight lanes are one segment, the throw lane bends so it is followed one tick at a time
+    bool sweptHit(const Lane& lane, size_t i, int32 from, const Vec2& center, double r) const
+    {
+        from = Max(from, lane.birth[i]);
+        
+        if(!lane.isThrow || m_now <= from+1)
+        {
+            return CapsuleHit(lane.at(i, from), lane.at(i, m_now), center, r);
+        }
+        
+        for (int32 tick = from; tick < m_now; ++tick)
+        {
+            if(CapsuleHit(lane.at(i, tick), lane.at(i, tick+1), center, r))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // x covered by the same path, x is linear in time on every lane
+    std::pair<double, double> sweptRangeX(const Lane& lane, size_t i, int32 from) const
+    {
+        const double x0 = lane.at(i, Max(from, lane.birth[i])).x;
+        const double x1 = lane.at(i, m_now).x;
+        return { Min(x0, x1), Max(x0, x1) };
+    }
+    
+    // takes a bullet out of play, its slot is freed by the next removeDead
+    void kill(Lane& lane, size_t i)
+    {
+        if(lane.alive[i])
+        {
+            lane.alive[i] = false;
+            m_killed.push_back(Expiry{m_now, static_cast<uint32>(i), lane.generation[i], static_cast<uint8>(&lane - m_lanes.data())});
+        }
+    }
+    
+    // frees bullets that were hit and pops the ones whose precomputed expiry has come, returns how many went;
+    // without expire the expired ones wait, so a sweep can still cover the ticks before they left
+    size_t removeDead(bool expire = true)
+    {
+        size_t removed = 0;
+        
+        for(const auto& killed : m_killed)
+        {
+            release(killed);
+            ++removed;
+        }
+        m_killed.clear();
+        
+        while(expire && !m_expiries.isEmpty() && m_expiries.front().tick <= m_now)
+        {
+            std::pop_heap(m_expiries.begin(), m_expiries.end(), ExpiresLater);
+            const Expiry expiry = m_expiries.back();
+            m_expiries.pop_back();
+            
+            // a slot that was freed by a hit and reused has a newer generation
+            Lane& lane = m_lanes[expiry.lane];
+            if(lane.generation[expiry.slot] == expiry.generation && lane.alive[expiry.slot])
+            {
+                lane.alive[expiry.slot] = false;
+                release(expiry);
+                ++removed;
+            }
+        }
+        
+        return removed;
+    }
+    
+    void killTeam(bool isEnemyTeam)
+    {
+        for(auto& lane : m_lanes)
+        {
+            for (auto i : s3d::step(lane.size()))
+            {
+                if(lane.isEnemyTeam[i] == isEnemyTeam)
+                {
+                    kill(lane, i);
+                }
+            }
+        }
+    }
+    
+    Lane& lane(BulletType type)
+    {
+        return m_lanes[static_cast<size_t>(type)];
+    }
+    
+    std::array<Lane, LaneCount>& getLanes()
+    {
+        return m_lanes;
+    }
+    
+    void hashInto(StateHash& hash) const
+    {
+        hash.add(m_now);
+        for(const auto& lane : m_lanes)
+        {
+            hash.add(lane.birth);
+            hash.add(lane.x0);
+            hash.add(lane.y0);
+            hash.add(lane.vx);
+            hash.add(lane.vy);
+            hash.add(lane.generation);
+            hash.add(lane.isEnemy);
+            hash.add(lane.isEnemyTeam);
+            hash.add(lane.alive);
+        }
+        for(const auto& free : m_free)
+        {
+            hash.add(free);
+        }
+        hash.add(m_expiries);
+    }
+    
+    void saveInto(SnapshotWriter& writer) const
+    {
+        writer.write(m_now);
+        for(const auto& lane : m_lanes)
+        {
+            writer.write(lane.birth);
+            writer.write(lane.x0);
+            writer.write(lane.y0);
+            writer.write(lane.vx);
+            writer.write(lane.vy);
+            writer.write(lane.generation);
+            writer.write(lane.isEnemy);
+            writer.write(lane.isEnemyTeam);
+            writer.write(lane.alive);
+        }
+        for(const auto& free : m_free)
+        {
+            writer.write(free);
+        }
+        writer.write(m_live);
+        writer.write(m_expiries);
+        writer.write(m_killed);
+    }
+    
+    bool loadFrom(SnapshotReader& reader)
+    {
+        if(!reader.read(m_now))
+        {
+            return false;
+        }
+        
+        for(auto& lane : m_lanes)
+        {
+            if(!reader.read(lane.birth) || !reader.read(lane.x0) || !reader.read(lane.y0) || !reader.read(lane.vx) || !reader.read(lane.vy)
+               || !reader.read(lane.generation) || !reader.read(lane.isEnemy) || !reader.read(lane.isEnemyTeam) || !reader.read(lane.alive))
+            {
+                return false;
+            }
+            
+            const size_t size = lane.size();
+            if(lane.x0.size() != size || lane.y0.size() != size || lane.vx.size() != size || lane.vy.size() != size
+               || lane.generation.size() != size || lane.isEnemy.size() != size || lane.isEnemyTeam.size() != size || lane.alive.size() != size)
+            {
+                return false;
+            }
+        }
+        
+        for(auto& free : m_free)
+        {
+            if(!reader.read(free))
+            {
+                return false;
+            }
+        }
+        
+        if(!reader.read(m_live) || !reader.read(m_expiries) || !reader.read(m_killed))
+        {
+            return false;
+        }
+        
+        return isConsistent();
+    }
+    
+    size_t count() const
+    {
+        size_t n = 0;
+        for(const auto live : m_live)
+        {
+            n += live;
+        }
+        return n;
+    }
+    
+    // slots ever handed out, live or free; only grows to the most bullets in flight at once
+    size_t slotCount() const
+    {
+        size_t n = 0;
+        for(const auto& lane : m_lanes)
+        {
+            n += lane.size();
+        }
+        return n;
+    }
+    
+    size_t freeCount() const
+    {
+        size_t n = 0;
+        for(const auto& free : m_free)
+        {
+            n += free.size();
+        }
+        return n;
+    }
+    
+    // pending expiries, stale ones of bullets that were hit early included until their tick comes
+    size_t expiryCount() const
+    {
+        return m_expiries.size();
+    }
+    
+private:
+    // when a slot's bullet leaves the lane, ordered as a min-heap on tick
+    // every slot and lane a loaded file refers to has to exist, and the live counts have to add up,
+    // otherwise the next spawn or release would write outside the lanes
+    bool isConsistent() const
+    {
+        std::array<size_t, LaneCount> pending = {};
+        for(const auto& killed : m_killed)
+        {
+            if(LaneCount <= killed.lane || m_lanes[killed.lane].size() <= killed.slot || m_lanes[killed.lane].alive[killed.slot])
+            {
+                return false;
+            }
+            ++pending[killed.lane];
+        }
+        
+        for(const auto& expiry : m_expiries)
+        {
+            if(LaneCount <= expiry.lane || m_lanes[expiry.lane].size() <= expiry.slot)
+            {
+                return false;
+            }
+        }
+        
+        for (size_t l = 0; l < LaneCount; ++l)
+        {
+            const Lane& lane = m_lanes[l];
+            for(const auto slot : m_free[l])
+            {
+                if(lane.size() <= slot || lane.alive[slot])
+                {
+                    return false;
+                }
+            }
+            
+            size_t alive = 0;
+            for(const auto flag : lane.alive)
+            {
+                alive += (flag != 0);
+            }
+            
+            if(m_live[l] != alive + pending[l] || m_live[l] + m_free[l].size() != lane.size())
+            {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    struct Expiry
+    {
+        int32 tick;
+        uint32 slot;
+        uint32 generation;
+        uint8 lane;
+        uint8 padding[3] = {};
+    };
+    
+    std::array<Lane, LaneCount> m_lanes;
+    std::array<Array<uint32>, LaneCount> m_free;
+    std::array<size_t, LaneCount> m_live = {};
+    Array<Expiry> m_expiries;
+    Array<Expiry> m_killed;
+    int32 m_now = 0;
+    
+    static bool ExpiresLater(const Expiry& a, const Expiry& b)
+    {
+        return (a.tick != b.tick) ? (b.tick < a.tick) : (b.lane != a.lane) ? (b.lane < a.lane) : (b.slot < a.slot);
+    }
+    
+    void pushExpiry(const Expiry& expiry)
+    {
+        m_expiries.push_back(expiry);
+        std::push_heap(m_expiries.begin(), m_expiries.end(), ExpiresLater);
+    }
+    
+    void release(const Expiry& expiry)
+    {
+        ++m_lanes[expiry.lane].generation[expiry.slot];
+        m_free[expiry.lane].push_back(expiry.slot);
+        --m_live[expiry.lane];
+    }
+    
+    // same bounds the per-tick check used to apply: the far side of the lane is given more room
+    static bool Outside(const Lane& lane, size_t i, const Vec2& pos)
+    {
+        const bool outsideX = lane.isEnemyTeam[i]
+            ? (pos.x < -50 || LaneWidth+150 < pos.x)
+            : (LaneWidth+50 < pos.x || pos.x < -150);
+        return outsideX || LaneHeight+50 < pos.y;
+    }
+    
+    // age at which the bullet is first outside, the estimates are snapped to what at() really returns
+    static int32 lifetime(const Lane& lane, size_t i)
+    {
+        const auto outsideAt = [&](int32 k){ return Outside(lane, i, lane.at(i, lane.birth[i] + k)); };
+        
+        if(outsideAt(1))
+        {
+            return 1;
+        }
+        
+        double estimate = Largest<double>;
+        const double x0 = lane.x0[i], y0 = lane.y0[i], vx = lane.vx[i], vy = lane.vy[i];
+        const double right = lane.isEnemyTeam[i] ? LaneWidth+150 : LaneWidth+50;
+        const double left = lane.isEnemyTeam[i] ? -50 : -150;
+        const double bottom = LaneHeight+50;
+        
+        if(0.0 < vx)
+        {
+            estimate = Min(estimate, (right - x0) / vx);
+        }
+        else if(vx < 0.0)
+        {
+            estimate = Min(estimate, (x0 - left) / -vx);
+        }
+        
+        if(lane.isThrow)
+        {
+            // 0.1k^2 - 12.1k + (y0 - bottom) = 0, the larger root is where it comes back down past the bottom
+            estimate = Min(estimate, (12.1 + std::sqrt(Max(0.0, 12.1*12.1 - 0.4*(y0 - bottom)))) / 0.2);
+        }
+        else if(0.0 < vy)
+        {
+            estimate = Min(estimate, (bottom - y0) / vy);
+        }
+        
+        if(Largest<int32> / 2 < estimate)
+        {
+            return Largest<int32> / 2;
+        }
+        
+        int32 k = Max(static_cast<int32>(estimate), 2);
+        while(2 < k && outsideAt(k-1))
+        {
+            --k;
+        }
+        while(!outsideAt(k))
+        {
+            ++k;
+        }
+        return k;
+    }
+};
+
+// one side's alive units sorted by x; the order is kept between ticks and repaired by an insertion
+// sort, units only pass each other through knockback so that is close to linear.
+// positions are a snapshot from the last update
+class LaneIndex
+{
+public:
+    static constexpr size_t NotFound = static_cast<size_t>(-1);
+    
+    // refreshes positions, drops units that died and adds the ones pushed since the last call
+    template <class Unit>
+    void update(Array<Unit>& units)
+    {
+        size_t count = 0;
+        for (const auto& entry : m_entries)
+        {
+            if(units[entry.index].alive())
+            {
+                m_entries[count++] = Entry{units[entry.index].getPos().x, entry.index};
+            }
+        }
+        m_entries.resize(count);
+        
+        for (size_t i = m_known; i < units.size(); ++i)
+        {
+            if(units[i].alive())
+            {
+                m_entries.push_back(Entry{units[i].getPos().x, i});
+            }
+        }
+        
+        // a loaded snapshot or a scripted fight adds everything at once, that is sorted properly
+        if(SortThreshold < units.size() - m_known)
+        {
+            m_known = units.size();
+            std::stable_sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b){ return a.x < b.x; });
+            return;
+        }
+        m_known = units.size();
+        
+        for (size_t i = 1; i < m_entries.size(); ++i)
+        {
+            const Entry entry = m_entries[i];
+            size_t j = i;
+            for (; 0 < j && entry.x < m_entries[j-1].x; --j)
+            {
+                m_entries[j] = m_entries[j-1];
+            }
+            m_entries[j] = entry;
+        }
+    }
+    
+    // remove_if that keeps the index numbering in step with the compacted array
+    template <class Unit, class Fty>
+    void removeIf(Array<Unit>& units, Fty&& isRemoved)
+    {
+        m_remap.resize(units.size());
+        
+        size_t count = 0, known = 0;
+        for (size_t i = 0; i < units.size(); ++i)
+        {
+            if(isRemoved(units[i]))
+            {
+                m_remap[i] = NotFound;
+            }
+            else
+            {
+                m_remap[i] = count;
+                if(count != i)
+                {
+                    units[count] = std::move(units[i]);
+                }
+                ++count;
+                known += (i < m_known);
+            }
+        }
+        units.erase(units.begin() + count, units.end());
+        
+        size_t kept = 0;
+        for (const auto& entry : m_entries)
+        {
+            if(entry.index < m_known && m_remap[entry.index] != NotFound)
+            {
+                m_entries[kept++] = Entry{entry.x, m_remap[entry.index]};
+            }
+        }
+        m_entries.resize(kept);
+        m_known = known;
+    }
+    
+    // forgets everything, the next update sorts the whole array again
+    void clear()
+    {
+        m_entries.clear();
+        m_known = 0;
+    }
+    
+    // indices of units in [x0, x1], returned in unit order so hits stay deterministic
+    void query(double x0, double x1, Array<size_t>& out) const
+    {
+        out.clear();
+        for (auto it = lowerBound(x0); it != m_entries.end() && it->x <= x1; ++it)
+        {
+            out << it->index;
+        }
+        std::sort(out.begin(), out.end());
+    }
+    
+    // the unit closest to x, NotFound on an empty side
+    size_t nearest(double x) const
+    {
+        if(m_entries.isEmpty())
+        {
+            return NotFound;
+        }
+        
+        const auto it = lowerBound(x);
+        if(it == m_entries.end())
+        {
+            return m_entries.back().index;
+        }
+        if(it == m_entries.begin() || (it->x - x) < (x - std::prev(it)->x))
+        {
+            return it->index;
+        }
+        return std::prev(it)->index;
+    }
+    
+    // sorted position of the first unit at or right of x
+    size_t rankOf(double x) const
+    {
+        return static_cast<size_t>(lowerBound(x) - m_entries.begin());
+    }
+    
+    // unit index by sorted position, 0 is the left-most
+    size_t at(size_t rank) const
+    {
+        return m_entries[rank].index;
+    }
+    
+    double xAt(size_t rank) const
+    {
+        return m_entries[rank].x;
+    }
+    
+    size_t size() const
+    {
+        return m_entries.size();
+    }
+    
+    bool isEmpty() const
+    {
+        return m_entries.isEmpty();
+    }
+    
+private:
+    struct Entry
+    {
+        double x;
+        size_t index;
+    };
+    
+    static constexpr size_t SortThreshold = 64;
+    
+    Array<Entry> m_entries;
+    Array<size_t> m_remap;
+    
+    // units below this index are in m_entries unless they died
+    size_t m_known = 0;
+    
+    Array<Entry>::const_iterator lowerBound(double x) const
+    {
+        return std::lower_bound(m_entries.begin(), m_entries.end(), x, [](const Entry& e, double v){ return e.x < v; });
+    }
+};
+
+enum class UnitKind : uint8
+{
+    Geki,   // 撃
+    Da,     // 打
+    Batsu,  // 伐
+    Sha,    // 射
+    Sei,    // 征
+};
+
+enum class BulletPattern : uint8
+{
+    None,
+    Straight,
+    Spread,
+    Rain,
+};
+
+struct UnitArchetype
+{
+    char32 glyph;
+    double speed;
+    double speedPerGrade;
+    int32 hp;
+    int32 hpPerGrade;
+    int32 fireIntervalMs;
+    bool fireIntervalByGrade;
+    double fallOffset;
+    BulletPattern pattern;
+    int32 cost;
+};
+
+// indexed by UnitKind, which is also the order of the item cards
+constexpr std::array<UnitArchetype, 5> UnitArchetypes =
+{{
+    { U'撃', 1.5, 0.0, 10, 0, 2000, true,  0.0,   BulletPattern::Straight, 200 },
+    { U'打', 2.0, 0.0, 10, 5, 0,    false, 0.0,   BulletPattern::None,     200 },
+    { U'伐', 5.0, 1.0, 25, 0, 0,    false, 0.0,   BulletPattern::None,     500 },
+    { U'射', 1.0, 0.0, 5,  0, 4000, false, 0.0,   BulletPattern::Spread,   500 },
+    { U'征', 3.0, 0.0, 5,  0, 500,  false, 200.0, BulletPattern::Rain,     1000 },
+}};
+
+constexpr const UnitArchetype& GetArchetype(UnitKind kind)
+{
+    return UnitArchetypes[static_cast<size_t>(kind)];
+}
+
+class Player
+{
+public:
+    Player(UnitKind kind=UnitKind::Da, int32 grade=1, bool isEnemy = false, Vec2 pos = Vec2(0,0))
+    :m_kind(kind)
+    ,m_grade(grade)
+    ,m_isEnemy(isEnemy)
+    ,m_pos(Vec2(pos.x,0))
+    ,m_isAlive(true)
+    ,m_coolTick(0)
+    {
+        const UnitArchetype& archetype = GetArchetype(kind);
+        
+        m_speed = archetype.speedPerGrade*grade + (isEnemy ? -archetype.speed : archetype.speed);
+        m_hp = archetype.hp + archetype.hpPerGrade*grade;
+        m_fireTicks = MillisecToTicks(archetype.fireIntervalByGrade ? archetype.fireIntervalMs/grade : archetype.fireIntervalMs);
+        m_fallPos = pos.y - archetype.fallOffset;
+    }
+    
+    const bool alive()
+    {
+        return m_isAlive;
+    }
+    
+    const bool isEnemy()
+    {
+        return m_isEnemy;
+    }
+    
+    UnitKind getKind()
+    {
+        return m_kind;
+    }
+    
+    const Vec2 getPos()
+    {
+        return m_pos;
+    }
+    
+    int32 getGrade()
+    {
+        return m_grade;
+    }
+    
+    // a unit read back from a file has to index the archetype table and the three card tiers
+    bool isValid() const
+    {
+        return static_cast<size_t>(m_kind) < UnitArchetypes.size() && 1 <= m_grade && m_grade <= 3;
+    }
+    
+    bool nockBack(int32 damage)
+    {
+        m_hp -= damage;
+        if(m_hp <= 0)
+        {
+            m_isAlive = false;
+            return true;
+        }
+        m_pos.moveBy(-m_speed*10, 0);
+        return false;
+    }
+    
+    void dead()
+    {
+        m_isAlive = false;
+    }
+    
+    const bool finished()
+    {
+        return !m_isAlive;
+    }
+    
+    // cooldown and movement only, so any number of units can advance at once
+    void advance()
+    {
+        ++m_coolTick;
+        m_volleyReady = false;
+        
+        if(m_isAlive)
+        {
+            if(GetArchetype(m_kind).pattern != BulletPattern::None && m_fireTicks < m_coolTick)
+            {
+                m_coolTick = 0;
+                m_volleyReady = true;
+                m_volleyPos = m_pos;
+            }
+            
+            if(m_fallPos > m_pos.y)
+            {
+                m_pos.moveBy(m_speed, 10.0);
+            }
+            else
+            {
+                m_pos.moveBy(m_speed, 0);
+            }
+            
+        }
+    }
+    
+    // spawns the volley decided in advance(), run serially in unit order
+    void fire(BulletStore& bullets)
+    {
+        if(!m_volleyReady)
+        {
+            return;
+        }
+        
+        switch (m_kind)
+        {
+            case UnitKind::Geki:
+                volley<UnitKind::Geki>(bullets);
+                break;
+            case UnitKind::Da:
+                volley<UnitKind::Da>(bullets);
+                break;
+            case UnitKind::Batsu:
+                volley<UnitKind::Batsu>(bullets);
+                break;
+            case UnitKind::Sha:
+                volley<UnitKind::Sha>(bullets);
+                break;
+            case UnitKind::Sei:
+                volley<UnitKind::Sei>(bullets);
+                break;
+        }
+    }
+    
+    void hashInto(StateHash& hash) const
+    {
+        hash.add(m_kind);
+        hash.add(m_isEnemy);
+        hash.add(m_grade);
+        hash.add(m_speed);
+        hash.add(m_pos.x);
+        hash.add(m_pos.y);
+        hash.add(m_hp);
+        hash.add(m_isAlive);
+        hash.add(m_coolTick);
+        hash.add(m_fireTicks);
+        hash.add(m_fallPos);
+    }
+    
+private:
+    UnitKind m_kind;
+    bool m_isEnemy;
+    int32 m_grade;
+    double m_speed;
+    Vec2 m_pos;
+    int32 m_hp;
+    bool m_isAlive;
+    int32 m_coolTick;
+    int32 m_fireTicks;
+    double m_fallPos;
+    
+    bool m_volleyReady = false;
+    Vec2 m_volleyPos = Vec2(0,0);
+    
+    template <UnitKind Kind>
+    void volley(BulletStore& bullets)
+    {
+        constexpr BulletPattern pattern = GetArchetype(Kind).pattern;
+        const Vec2 pos = m_volleyPos;
+        
+        if constexpr (pattern == BulletPattern::Straight)
+        {
+            bullets.spawn(BulletType::Normal,m_isEnemy,m_isEnemy,pos,10.0);
+        }
+        else if constexpr (pattern == BulletPattern::Spread)
+        {
+            bullets.spawn(BulletType::Throw,m_isEnemy,m_isEnemy,pos,3.0);
+            bullets.spawn(BulletType::Throw,m_isEnemy,m_isEnemy,pos,6.0);
+            bullets.spawn(BulletType::Throw,m_isEnemy,m_isEnemy,pos,9.0);
+            if(2 <= m_grade)
+            {
+                bullets.spawn(BulletType::Throw,m_isEnemy,m_isEnemy,pos,1.0);
+            }
+            if(3 <= m_grade)
+            {
+                bullets.spawn(BulletType::Throw,m_isEnemy,m_isEnemy,pos,12.0);
+            }
+        }
+        else if constexpr (pattern == BulletPattern::Rain)
+        {
+            bullets.spawn(BulletType::Fall,m_isEnemy,m_isEnemy,pos,10.0);
+            if(2 <= m_grade)
+            {
+                bullets.spawn(BulletType::FallThrow,m_isEnemy,m_isEnemy,pos,10.0);
+            }
+            if(3 <= m_grade)
+            {
+                bullets.spawn(BulletType::FallThrow,!m_isEnemy,m_isEnemy,pos,10.0);
+            }
+        }
+    }
+};
+
+// one row of the wave table, in effect from startSecond until the next row starts
+struct WaveRow
+{
+    int32 startSecond;
+    int32 waitMinMs;
+    int32 waitMaxMs;
+    int32 waitStepMs;
+    int32 burst;
+    int32 grade;
+    
+    // tried in this order, each kind with its weight
+    Array<std::pair<UnitKind, int32>> mix;
+};
+
+// how enemies arrive over a match, the default is the original hand-written ladder
+struct WaveTable
+{
+    Array<WaveRow> rows;
+    
+    // multiplies how often spawns happen, for stress runs
+    double rate = 1.0;
+    
+    static constexpr double MinRate = 0.01;
+    static constexpr double MaxRate = 1000.0;
+    static constexpr int32 MaxBurst = 100;
+    
+    // the shortest gap between two spawn steps, anything denser than one step per 1/TickRate tick is a typo
+    static constexpr double MinStepTicks = 1.0 / TickRate;
+    
+    // a wait in ticks at this table's rate, fractional so that high rates do not round down to nothing
+    double stepTicks(int32 waitMs) const
+    {
+        return waitMs * TickRate / 1000.0 / rate;
+    }
+    
+    bool isValid() const
+    {
+        if(rows.isEmpty() || !(MinRate <= rate && rate <= MaxRate))
+        {
+            return false;
+        }
+        return rows.all([this](const WaveRow& row){ return 0 < row.waitMinMs && row.burst <= MaxBurst && MinStepTicks <= stepTicks(row.waitMinMs); });
+    }
+    
+    static WaveTable Default()
+    {
+        const Array<std::pair<UnitKind, int32>> mix =
+        {
+            {UnitKind::Geki, 40}, {UnitKind::Da, 20}, {UnitKind::Batsu, 20}, {UnitKind::Sha, 10}, {UnitKind::Sei, 11},
+        };
+        
+        WaveTable table;
+        table.rows =
+        {
+            WaveRow{0,  2000, 5000, 1000, 1, 1, mix},
+            WaveRow{46, 2000, 5000, 1000, 1, 2, mix},
+            WaveRow{75, 2000, 2000, 1000, 1, 2, mix},
+            WaveRow{91, 2000, 2000, 1000, 1, 3, mix},
+        };
+        return table;
+    }
+    
+    // rows of  start_s,wait_min_ms,wait_max_ms,wait_step_ms,burst,grade,mix  where mix reads like "撃:40 打:20",
+    // an optional  rate,<multiplier>  row scales the spawn rate, anything malformed rejects the whole file
+    static Optional<WaveTable> Load(const FilePath& path)
+    {
+        const CSVData csv(path);
+        if(!csv)
+        {
+            return none;
+        }
+        
+        WaveTable table;
+        for (size_t row = 0; row < csv.rows(); ++row)
+        {
+            if(csv.columns(row) == 0 || csv[row][0].isEmpty() || csv[row][0].starts_with(U'#') || csv[row][0] == U"start_s")
+            {
+                continue;
+            }
+            
+            if(csv[row][0] == U"rate")
+            {
+                const auto rate = (2 <= csv.columns(row)) ? ParseOpt<double>(csv[row][1]) : none;
+                if(!rate || !(MinRate <= *rate && *rate <= MaxRate))
+                {
+                    return none;
+                }
+                table.rate = *rate;
+                continue;
+            }
+            
+            if(csv.columns(row) < 7)
+            {
+                return none;
+            }
+            
+            std::array<Optional<int32>, 6> values;
+            for (auto i : step(values.size()))
+            {
+                values[i] = ParseOpt<int32>(csv[row][i]);
+                if(!values[i])
+                {
+                    return none;
+                }
+            }
+            
+            WaveRow wave{*values[0], *values[1], *values[2], *values[3], *values[4], *values[5], {}};
+            if(wave.waitMinMs <= 0 || wave.waitMaxMs < wave.waitMinMs || wave.waitStepMs <= 0 || wave.burst < 1 || wave.grade < 1 || 3 < wave.grade)
+            {
+                return none;
+            }
+            
+            if(!table.rows.isEmpty() && wave.startSecond <= table.rows.back().startSecond)
+            {
+                return none;
+            }
+            
+            for(const auto& entry : csv[row][6].split(U' '))
+            {
+                const auto kind = std::find_if(UnitArchetypes.begin(), UnitArchetypes.end(), [&](const UnitArchetype& archetype){ return !entry.isEmpty() && archetype.glyph == entry[0]; });
+                const auto weight = (3 <= entry.size() && entry[1] == U':') ? ParseOpt<int32>(entry.substr(2)) : none;
+                if(kind == UnitArchetypes.end() || !weight || *weight <= 0)
+                {
+                    return none;
+                }
+                wave.mix.emplace_back(static_cast<UnitKind>(kind - UnitArchetypes.begin()), *weight);
+            }
+            
+            if(wave.mix.isEmpty())
+            {
+                return none;
+            }
+            
+            table.rows << wave;
+        }
+        
+        if(!table.isValid())
+        {
+            return none;
+        }
+        
+        return table;
+    }
+    
+    // the last row that has started, the first row also covers anything before it
+    const WaveRow& rowAt(int32 second) const
+    {
+        size_t i = 0;
+        while(i+1 < rows.size() && rows[i+1].startSecond <= second)
+        {
+            ++i;
+        }
+        return rows[i];
+    }
+};
+
+// an enemy due on a given tick
+struct SpawnEntry
+{
+    int32 tick;
+    int32 grade;
+    UnitKind kind;
+};
+
+// turns the wave table into a queue of spawns some way ahead, the simulation only pops what is due;
+// nothing in it depends on how the match goes, so the queue is the same for a given seed and table
+class SpawnDirector
+{
+public:
+    static constexpr int32 FirstSpawnMs = 1000;
+    
+    // how far ahead each refill plans
+    static constexpr int32 ScheduleSeconds = 30;
+    
+    // a refill stops here even short of the horizon, the rest is planned by the next one
+    static constexpr size_t MaxScheduleEntries = 16384;
+    
+    // stress runs set the rate directly, so it is clamped here as well as in WaveTable::Load
+    SpawnDirector(const WaveTable& table, uint64 seed)
+    : m_table(table)
+    , m_random(seed)
+    {
+        m_table.rate = std::isnan(table.rate) ? 1.0 : Clamp(table.rate, WaveTable::MinRate, WaveTable::MaxRate);
+        m_nextTick = m_table.stepTicks(FirstSpawnMs);
+    }
+    
+    // calls spawn(kind, grade) for everything due by this tick
+    template <class Fty>
+    void spawnDue(int32 tick, Fty&& spawn)
+    {
+        for (;;)
+        {
+            if(m_cursor == m_schedule.size())
+            {
+                refill();
+            }
+            
+            const SpawnEntry& entry = m_schedule[m_cursor];
+            if(tick < entry.tick)
+            {
+                return;
+            }
+            
+            spawn(entry.kind, entry.grade);
+            ++m_cursor;
+        }
+    }
+    
+    void hashInto(StateHash& hash) const
+    {
+        hash.add(m_nextTick);
+        hash.add(m_schedule.size() - m_cursor);
+    }
+    
+    // the table is configuration and is not part of the snapshot
+    void saveInto(SnapshotWriter& writer) const
+    {
+        writer.write(m_random);
+        writer.write(m_nextTick);
+        writer.write(m_schedule);
+        writer.write(static_cast<uint64>(m_cursor));
+    }
+    
+    bool loadFrom(SnapshotReader& reader)
+    {
+        uint64 cursor = 0;
+        if(!reader.read(m_random) || !reader.read(m_nextTick) || !reader.read(m_schedule) || !reader.read(cursor) || m_schedule.size() < cursor || !(0.0 <= m_nextTick && m_nextTick < std::numeric_limits<int32>::max()))
+        {
+            return false;
+        }
+        
+        for(const auto& entry : m_schedule)
+        {
+            if(UnitArchetypes.size() <= static_cast<size_t>(entry.kind) || entry.grade < 1 || 3 < entry.grade)
+            {
+                return false;
+            }
+        }
+        m_cursor = static_cast<size_t>(cursor);
+        return true;
+    }
+    
+private:
+    WaveTable m_table;
+    SimRandom m_random;
+    double m_nextTick = 0.0;
+    Array<SpawnEntry> m_schedule;
+    size_t m_cursor = 0;
+    
+    void refill()
+    {
+        m_schedule.clear();
+        m_cursor = 0;
+        
+        const double horizon = m_nextTick + ScheduleSeconds*TickRate;
+        while(m_nextTick < horizon && m_schedule.size() < MaxScheduleEntries)
+        {
+            const int32 tick = static_cast<int32>(std::ceil(m_nextTick));
+            const WaveRow& row = m_table.rowAt(tick/TickRate);
+            
+            int32 waitMs = row.waitMinMs;
+            if(row.waitMinMs < row.waitMaxMs)
+            {
+                waitMs += m_random.range(0, (row.waitMaxMs-row.waitMinMs)/row.waitStepMs) * row.waitStepMs;
+            }
+            
+            int32 totalWeight = 0;
+            for(const auto& entry : row.mix)
+            {
+                totalWeight += entry.second;
+            }
+            
+            for (auto i : step(row.burst))
+            {
+                int32 n = m_random.range(0, totalWeight-1);
+                UnitKind kind = row.mix.back().first;
+                for(const auto& entry : row.mix)
+                {
+                    if(n < entry.second)
+                    {
+                        kind = entry.first;
+                        break;
+                    }
+                    n -= entry.second;
+                }
+                m_schedule.push_back(SpawnEntry{tick, row.grade, kind});
+            }
+            
+            m_nextTick += Max(m_table.stepTicks(waitMs), WaveTable::MinStepTicks);
+        }
+    }
+};
+
+// what the player did during one tick
+struct SimInput
+{
+    Optional<size_t> item;
+    bool bomb = false;
+};
+
+enum class SimEventType
+{
+    Select,
+    Cancel,
+    PowerUp,
+    Hit,
+    Damage,
+    Kill,
+    Breakthrough,
+    Bomb,
+};
+
+// side effects the presentation layer turns into sounds and particles
+struct SimEvent
+{
+    SimEventType type;
+    Vec2 pos = Vec2(0,0);
+    int32 count = 0;
+    bool isEnemy = false;
+};
+
+// Solo is the original match against the spawn director, in Versus the enemy side is bought by a second player
+enum class SimMode : uint8
+{
+    Solo,
+    Versus,
+};
+
+// what the enemy side owns in versus mode, the player side keeps its own members
+struct SideEconomy
+{
+    int32 score = 0;
+    int32 energy = 2500;
+    int32 coolTick = 0;
+    
+    // player units that broke through to the enemy's end
+    int32 deadCount = 0;
+    
+    Array<int32> itemNumber = {0,0,0,0,0};
+};
+
+class Simulation
+{
+public:
+    static constexpr int32 ItemCount = static_cast<int32>(UnitArchetypes.size());
+    static constexpr int32 MaxEnergy = 100000;
+    static constexpr int32 MaxDeadCount = 5;
+    
+    // events kept between two clearEvents calls, older ones are dropped past this
+    static constexpr size_t EventCapacity = 4096;
+    
+    explicit Simulation(uint64 seed = 0, const WaveTable& waves = WaveTable::Default(), SimMode mode = SimMode::Solo)
+    : m_seed(seed)
+    , m_mode(mode)
+    , m_director(waves, seed)
+    {
+        m_players.reserve(UnitReserve);
+        m_enemies.reserve(UnitReserve);
+    }
+    
+    // rivalInput buys for the enemy side and is ignored outside versus mode
+    void step(const SimInput& input, const SimInput& rivalInput = SimInput())
+    {
+        ++m_tick;
+        ++m_coolTick;
+        
+        if(m_energy < MaxEnergy)
+        {
+            m_energy += (1+m_itemNumber.sum()/(ItemCount*2));
+        }
+        
+        if(m_mode == SimMode::Versus)
+        {
+            ++m_rival.coolTick;
+            
+            if(m_rival.energy < MaxEnergy)
+            {
+                m_rival.energy += (1+m_rival.itemNumber.sum()/(ItemCount*2));
+            }
+        }
+        
+        {
+            ScopedPhase phase(m_profiler, FramePhase::Spawn);
+            
+            if(m_mode == SimMode::Solo)
+            {
+                respawn();
+            }
+            
+            if(input.item)
+            {
+                buy(*input.item, false);
+            }
+            
+            if(m_mode == SimMode::Versus && rivalInput.item)
+            {
+                buy(*rivalInput.item, true);
+            }
+        }
+        
+        {
+            ScopedPhase phase(m_profiler, FramePhase::Collision);
+            collide();
+        }
+        
+        {
+            ScopedPhase phase(m_profiler, FramePhase::Update);
+            
+            parallelFor(m_players.size(), UnitChunkSize, [this](size_t, size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    m_players[i].advance();
+                }
+            });
+            
+            parallelFor(m_enemies.size(), UnitChunkSize, [this](size_t, size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    m_enemies[i].advance();
+                }
+            });
+            
+            for(auto& player : m_players)
+            {
+                player.fire(m_bullets);
+            }
+            
+            for(auto& enemy : m_enemies)
+            {
+                enemy.fire(m_bullets);
+            }
+            
+            m_bullets.update();
+        }
+        
+        {
+            ScopedPhase phase(m_profiler, FramePhase::Despawn);
+            
+            // only the front of each side can be past the far end
+            m_playerIndex.update(m_players);
+            m_enemyIndex.update(m_enemies);
+            
+            for (size_t rank = m_playerIndex.size(); 0 < rank && LaneWidth+100 < m_playerIndex.xAt(rank-1); --rank)
+            {
+                Player& player = m_players[m_playerIndex.at(rank-1)];
+                player.dead();
+                m_score += 1000;
+                emit(SimEventType::Breakthrough, player.getPos(), 0, false);
+                
+                if(m_mode == SimMode::Versus && MaxDeadCount <= ++m_rival.deadCount && !m_isEndless)
+                {
+                    m_isGameOver = true;
+                }
+            }
+            
+            for (size_t rank = 0; rank < m_enemyIndex.size() && m_enemyIndex.xAt(rank) < -100; ++rank)
+            {
+                Player& enemy = m_enemies[m_enemyIndex.at(rank)];
+                ++m_deadCount;
+                scoreRival(1000);
+                emit(SimEventType::Breakthrough, enemy.getPos(), 0, true);
+                if(MaxDeadCount <= m_deadCount && !m_isEndless)
+                {
+                    m_isGameOver = true;
+                }
+                enemy.dead();
+            }
+        }
+        
+        {
+            ScopedPhase phase(m_profiler, FramePhase::Bomb);
+            
+            if(input.bomb && 5000 < m_score)
+            {
+                m_score -= 5000;
+                emit(SimEventType::Bomb, Vec2(0,0), 10, false);
+                
+                m_bullets.killTeam(true);
+                for(auto& enemy : m_enemies)
+                {
+                    enemy.dead();
+                }
+            }
+            
+            if(m_mode == SimMode::Versus && rivalInput.bomb && 5000 < m_rival.score)
+            {
+                m_rival.score -= 5000;
+                emit(SimEventType::Bomb, Vec2(0,0), 10, true);
+                
+                m_bullets.killTeam(false);
+                for(auto& player : m_players)
+                {
+                    player.dead();
+                }
+            }
+        }
+        
+        {
+            ScopedPhase phase(m_profiler, FramePhase::Despawn);
+            
+            const size_t unitCount = m_players.size() + m_enemies.size();
+            const size_t deadBullets = m_bullets.removeDead(isBulletTick());
+            m_playerIndex.removeIf(m_players, [](Player& p){ return p.finished(); });
+            m_enemyIndex.removeIf(m_enemies, [](Player& e){ return e.finished(); });
+            
+            if(m_profiler)
+            {
+                m_profiler->addCount(FrameCounter::DeadUnits, unitCount - m_players.size() - m_enemies.size());
+                m_profiler->addCount(FrameCounter::DeadBullets, deadBullets);
+                m_profiler->setCount(FrameCounter::Players, m_players.size());
+                m_profiler->setCount(FrameCounter::Enemies, m_enemies.size());
+                m_profiler->setCount(FrameCounter::Bullets, m_bullets.count());
+            }
+        }
+    }
+    
+    // time and counters go to the profiler while one is attached
+    void setProfiler(PhaseProfiler* profiler)
+    {
+        m_profiler = profiler;
+    }
+    
+    // without a job system everything runs on the calling thread, the results are identical either way
+    void setJobSystem(JobSystem* jobs)
+    {
+        m_jobs = jobs;
+    }
+    
+    // checks that compare every event of a big fight need more room than a frame's worth
+    void setEventCapacity(size_t capacity)
+    {
+        m_events = EventRing<SimEvent>(Max<size_t>(capacity, 1));
+    }
+    
+    // breakthroughs still count but never end the match, so a soak run stays one match throughout
+    void setEndless(bool isEndless)
+    {
+        m_isEndless = isEndless;
+    }
+    
+    // one collision pass over the current state without advancing the tick, for the load tests
+    void collideOnce()
+    {
+        collide();
+    }
+    
+    // bullets are checked every interval ticks against the path they covered since the last check,
+    // so big fights can trade hit timing for CPU without bullets passing through units
+    void setCollisionInterval(int32 interval)
+    {
+        m_collisionInterval = Max(interval, 1);
+    }
+    
+    Array<Player>& getPlayers()
+    {
+        return m_players;
+    }
+    
+    Array<Player>& getEnemies()
+    {
+        return m_enemies;
+    }
+    
+    BulletStore& getBullets()
+    {
+        return m_bullets;
+    }
+    
+    const Array<Player>& getPlayers() const
+    {
+        return m_players;
+    }
+    
+    const Array<Player>& getEnemies() const
+    {
+        return m_enemies;
+    }
+    
+    const BulletStore& getBullets() const
+    {
+        return m_bullets;
+    }
+    
+    const EventRing<SimEvent>& getEvents() const
+    {
+        return m_events;
+    }
+    
+    void clearEvents()
+    {
+        m_events.clear();
+    }
+    
+    // drops events pushed after the first count, used to silence re-simulated ticks
+    void truncateEvents(size_t count)
+    {
+        m_events.truncate(count);
+    }
+    
+    const Array<int32>& getItemNumber() const
+    {
+        return m_itemNumber;
+    }
+    
+    int32 getScore() const
+    {
+        return m_score;
+    }
+    
+    int32 getEnergy() const
+    {
+        return m_energy;
+    }
+    
+    int32 getDeadCount() const
+    {
+        return m_deadCount;
+    }
+    
+    bool isGameOver() const
+    {
+        return m_isGameOver;
+    }
+    
+    SimMode getMode() const
+    {
+        return m_mode;
+    }
+    
+    const SideEconomy& getRival() const
+    {
+        return m_rival;
+    }
+    
+    int32 getTick() const
+    {
+        return m_tick;
+    }
+    
+    uint64 getSeed() const
+    {
+        return m_seed;
+    }
+    
+    static constexpr uint32 SnapshotMagic = 0x504E534A; // "JSNP"
+    static constexpr uint32 SnapshotVersion = 3;
+    
+    // the whole match state as one byte image, bytes keeps its capacity between calls
+    void saveSnapshot(Array<uint8>& bytes) const
+    {
+        SnapshotWriter writer(bytes);
+        
+        writer.write(SnapshotMagic);
+        writer.write(SnapshotVersion);
+        writer.write(m_seed);
+        writer.write(m_tick);
+        writer.write(m_score);
+        writer.write(m_energy);
+        writer.write(m_deadCount);
+        writer.write(m_isGameOver);
+        writer.write(m_coolTick);
+        writer.write(m_itemNumber);
+        writer.write(m_mode);
+        writer.write(m_rival.score);
+        writer.write(m_rival.energy);
+        writer.write(m_rival.coolTick);
+        writer.write(m_rival.deadCount);
+        writer.write(m_rival.itemNumber);
+        writer.write(m_players);
+        writer.write(m_enemies);
+        m_bullets.saveInto(writer);
+        m_director.saveInto(writer);
+    }
+    
+    // the wave table has to match the one the snapshot was taken with; on false the state is not usable
+    bool loadSnapshot(const Array<uint8>& bytes)
+    {
+        SnapshotReader reader(bytes);
+        m_playerIndex.clear();
+        m_enemyIndex.clear();
+        
+        uint32 magic = 0, version = 0;
+        if(!reader.read(magic) || magic != SnapshotMagic || !reader.read(version) || version != SnapshotVersion)
+        {
+            return false;
+        }
+        
+        if(!reader.read(m_seed) || !reader.read(m_tick) || !reader.read(m_score) || !reader.read(m_energy) || !reader.read(m_deadCount)
+           || !reader.read(m_isGameOver) || !reader.read(m_coolTick) || !reader.read(m_itemNumber)
+           || !reader.read(m_mode) || !reader.read(m_rival.score) || !reader.read(m_rival.energy) || !reader.read(m_rival.coolTick) || !reader.read(m_rival.deadCount) || !reader.read(m_rival.itemNumber)
+           || !reader.read(m_players) || !reader.read(m_enemies))
+        {
+            return false;
+        }
+        
+        if(m_itemNumber.size() != static_cast<size_t>(ItemCount) || m_rival.itemNumber.size() != static_cast<size_t>(ItemCount)
+           || (m_mode != SimMode::Solo && m_mode != SimMode::Versus))
+        {
+            return false;
+        }
+        
+        const auto isValid = [](const Player& unit){ return unit.isValid(); };
+        if(!m_players.all(isValid) || !m_enemies.all(isValid) || !m_bullets.loadFrom(reader) || !m_director.loadFrom(reader))
+        {
+            return false;
+        }
+        
+        return reader.isEnd();
+    }
+    
+    uint64 stateHash() const
+    {
+        StateHash hash;
+        
+        hash.add(m_tick);
+        hash.add(m_score);
+        hash.add(m_energy);
+        hash.add(m_deadCount);
+        hash.add(m_isGameOver);
+        hash.add(m_coolTick);
+        m_director.hashInto(hash);
+        hash.add(m_itemNumber);
+        
+        // solo hashes stay as they were so recorded replays still match
+        if(m_mode == SimMode::Versus)
+        {
+            hash.add(m_rival.score);
+            hash.add(m_rival.energy);
+            hash.add(m_rival.coolTick);
+            hash.add(m_rival.deadCount);
+            hash.add(m_rival.itemNumber);
+        }
+        
+        hash.add(m_players.size());
+        for(const auto& player : m_players)
+        {
+            player.hashInto(hash);
+        }
+        
+        hash.add(m_enemies.size());
+        for(const auto& enemy : m_enemies)
+        {
+            enemy.hashInto(hash);
+        }
+        
+        m_bullets.hashInto(hash);
+        return hash.value();
+    }
+    
+private:
+    Array<Player> m_players;
+    Array<Player> m_enemies;
+    BulletStore m_bullets;
+    int32 m_collisionInterval = 1;
+    LaneIndex m_playerIndex;
+    LaneIndex m_enemyIndex;
+    EventRing<SimEvent> m_events{EventCapacity};
+    Array<int32> m_itemNumber = {0,0,0,0,0};
+    
+    int32 m_score = 0;
+    int32 m_energy = 2500;
+    int32 m_deadCount = 0;
+    bool m_isGameOver = false;
+    bool m_isEndless = false;
+    
+    int32 m_tick = 0;
+    int32 m_coolTick = 0;
+    
+    uint64 m_seed;
+    SimMode m_mode;
+    SideEconomy m_rival;
+    SpawnDirector m_director;
+    PhaseProfiler* m_profiler = nullptr;
+    JobSystem* m_jobs = nullptr;
+    
+    // a detected contact, applied later in a fixed order
+    struct HitCandidate
+    {
+        uint32 source;
+        uint32 target;
+    };
+    
+    static constexpr size_t UnitChunkSize = 256;
+    
+    // units are trivially copyable and removal compacts in place, so the arrays only grow past this in heavy waves
+    static constexpr size_t UnitReserve = 1024;
+    static constexpr size_t BulletChunkSize = 1024;
+    
+    // kept between ticks so a steady fight reuses their capacity; melee hits are gathered into one list to
+    // sort them into unit order, bullet hits are applied straight from the chunks, which are already in order
+    Array<Array<HitCandidate>> m_chunkHits;
+    Array<Array<size_t>> m_chunkCandidates;
+    Array<HitCandidate> m_meleeHits;
+    Array<size_t> m_serialCandidates;
+    
+    // knockback each unit has taken since the contacts in hand were detected, and the most of it on each side
+    Array<double> m_playerShift;
+    Array<double> m_enemyShift;
+    double m_playerMaxShift = 0.0;
+    double m_enemyMaxShift = 0.0;
+    
+    // how far any unit can be from where the lane indices last saw it
+    double m_indexSlack = 0.0;
+    
+    void emit(SimEventType type, const Vec2& pos, int32 count, bool isEnemy)
+    {
+        m_events.push(SimEvent{type, pos, count, isEnemy});
+    }
+    
+    void respawn()
+    {
+        if(m_isGameOver)
+        {
+            return;
+        }
+        
+        const Vec2 spawnPos(LaneWidth+50, LaneHeight/2+100);
+        
+        m_director.spawnDue(m_tick, [&](UnitKind kind, int32 grade)
+        {
+            m_enemies.emplace_back(kind,grade,true,spawnPos);
+        });
+    }
+    
+    void scoreRival(int32 points)
+    {
+        if(m_mode == SimMode::Versus)
+        {
+            m_rival.score += points;
+        }
+    }
+    
+    // isEnemy buys for the enemy side, which only happens in versus mode
+    void buy(size_t i, bool isEnemy)
+    {
+        if(m_isGameOver || static_cast<size_t>(ItemCount) <= i)
+        {
+            return;
+        }
+        
+        int32& energy = isEnemy ? m_rival.energy : m_energy;
+        int32& coolTick = isEnemy ? m_rival.coolTick : m_coolTick;
+        int32& itemNumber = (isEnemy ? m_rival.itemNumber : m_itemNumber)[i];
+        Array<Player>& units = isEnemy ? m_enemies : m_players;
+        const Vec2 spawnPos(isEnemy ? LaneWidth+50 : -50, LaneHeight/2+100);
+        
+        // the grade and cost multiplier go up at 10 and 25 of a kind
+        const int32 grade = (itemNumber < 10) ? 1 : (itemNumber < 25) ? 2 : 3;
+        const int32 cost = UnitArchetypes[i].cost*grade;
+        const int32 coolTime = MillisecToTicks((grade == 1) ? 500 : 1000);
+        
+        if(cost < energy && coolTime < coolTick)
+        {
+            ++itemNumber;
+            if(itemNumber==10)
+            {
+                emit(SimEventType::PowerUp, spawnPos, 0, isEnemy);
+            }
+            emit(SimEventType::Select, spawnPos, 0, isEnemy);
+            coolTick = 0;
+            energy -= cost;
+            units.emplace_back(static_cast<UnitKind>(i),grade,isEnemy,spawnPos);
+        }
+        else
+        {
+            emit(SimEventType::Cancel, spawnPos, 0, isEnemy);
+        }
+    }
+    
+    // contacts are detected this much wider than the bodies, so they still hold while the pushes on
+    // the two sides add up to less than this; past that the pass finishes serially
+    static constexpr double KnockBackMargin = 100.0;
+    
+    // two bodies, circles of 30, touch
+    static constexpr double MeleeReach = 30.0 + 30.0;
+    
+    // a bullet is a circle of 20 and a unit one of 30
+    static constexpr double BulletHitRadius = 20.0 + 30.0;
+    
+    bool isBulletTick() const
+    {
+        return m_tick % m_collisionInterval == 0;
+    }
+    
+    template <class Fty>
+    void parallelFor(size_t count, size_t chunkSize, Fty&& body)
+    {
+        if(m_jobs)
+        {
+            m_jobs->parallelFor(count, chunkSize, body);
+        }
+        else
+        {
+            for (size_t begin = 0, chunk = 0; begin < count; begin += chunkSize, ++chunk)
+            {
+                body(chunk, begin, Min(count, begin+chunkSize));
+            }
+        }
+    }
+    
+    // runs detectOne(chunkHits, candidates, i) for every i in parallel, returns how many chunks of m_chunkHits
+    // it filled; read one after another they hold the hits in index order
+    template <class Fty>
+    size_t detect(size_t count, size_t chunkSize, Fty&& detectOne)
+    {
+        const size_t chunks = (count + chunkSize - 1) / chunkSize;
+        if(m_chunkHits.size() < chunks)
+        {
+            m_chunkHits.resize(chunks);
+            m_chunkCandidates.resize(chunks);
+        }
+        
+        parallelFor(count, chunkSize, [&](size_t chunk, size_t begin, size_t end)
+        {
+            Array<HitCandidate>& hits = m_chunkHits[chunk];
+            hits.clear();
+            
+            for (size_t i = begin; i < end; ++i)
+            {
+                detectOne(hits, m_chunkCandidates[chunk], i);
+            }
+        });
+        
+        return chunks;
+    }
+    
+    // contacts are found in parallel a little wider than the bodies, then applied serially against the
+    // positions of the moment, in the order the nested loops used; once knockback has pushed a unit
+    // further than the detection allowed for, the rest of the pass runs serially
+    void collide()
+    {
+        m_playerIndex.update(m_players);
+        m_enemyIndex.update(m_enemies);
+        m_indexSlack = 0.0;
+        m_playerMaxShift = 0.0;
+        m_enemyMaxShift = 0.0;
+        resetShifts();
+        
+        // only players within reach of the left-most enemy can touch anything
+        const size_t first = m_enemyIndex.isEmpty() ? m_playerIndex.size() : m_playerIndex.rankOf(m_enemyIndex.xAt(0)-MeleeReach-KnockBackMargin);
+        
+        const size_t meleeChunks = detect(m_playerIndex.size()-first, UnitChunkSize, [this, first](Array<HitCandidate>& hits, Array<size_t>& candidates, size_t rank)
+        {
+            const size_t p = m_playerIndex.at(first+rank);
+            const Vec2 pos = m_players[p].getPos();
+            
+            m_enemyIndex.query(pos.x-MeleeReach-KnockBackMargin, pos.x+MeleeReach+KnockBackMargin, candidates);
+            
+            for(const auto i : candidates)
+            {
+                if(pos.distanceFromSq(m_enemies[i].getPos()) <= (MeleeReach+KnockBackMargin)*(MeleeReach+KnockBackMargin))
+                {
+                    hits.push_back(HitCandidate{static_cast<uint32>(p), static_cast<uint32>(i)});
+                }
+            }
+        });
+        
+        // detected front to back, applied in unit order as before
+        m_meleeHits.clear();
+        for (size_t chunk = 0; chunk < meleeChunks; ++chunk)
+        {
+            m_meleeHits.insert(m_meleeHits.end(), m_chunkHits[chunk].begin(), m_chunkHits[chunk].end());
+        }
+        std::sort(m_meleeHits.begin(), m_meleeHits.end(), [](const HitCandidate& a, const HitCandidate& b){ return (a.source != b.source) ? a.source < b.source : a.target < b.target; });
+        
+        for(const auto& hit : m_meleeHits)
+        {
+            if(isTouching(hit.source, hit.target))
+            {
+                applyMelee(hit.source, hit.target);
+                
+                if(isDetectionStale())
+                {
+                    collideMeleeFrom(hit.source, hit.target+1);
+                    break;
+                }
+            }
+        }
+        
+        if(!isBulletTick())
+        {
+            return;
+        }
+        
+        const int32 from = m_bullets.now() - m_collisionInterval;
+        
+        for(auto& lane : m_bullets.getLanes())
+        {
+            resetShifts();
+            
+            const size_t bulletChunks = detect(lane.size(), BulletChunkSize, [this, &lane, from](Array<HitCandidate>& hits, Array<size_t>& candidates, size_t b)
+            {
+                if(!lane.alive[b])
+                {
+                    return;
+                }
+                
+                const auto [x0, x1] = m_bullets.sweptRangeX(lane, b, from);
+                const bool isEnemyTeam = lane.isEnemyTeam[b];
+                Array<Player>& targets = isEnemyTeam ? m_players : m_enemies;
+                const double pad = BulletHitRadius + KnockBackMargin + m_indexSlack;
+                
+                (isEnemyTeam ? m_playerIndex : m_enemyIndex).query(x0-pad, x1+pad, candidates);
+                
+                for(const auto i : candidates)
+                {
+                    if(m_bullets.sweptHit(lane, b, from, targets[i].getPos(), BulletHitRadius+KnockBackMargin))
+                    {
+                        hits.push_back(HitCandidate{static_cast<uint32>(b), static_cast<uint32>(i)});
+                    }
+                }
+            });
+            
+            bool isStale = false;
+            for (size_t chunk = 0; chunk < bulletChunks && !isStale; ++chunk)
+            {
+                for(const auto& hit : m_chunkHits[chunk])
+                {
+                    if(isShot(lane, from, hit.source, hit.target))
+                    {
+                        applyBullet(lane, hit.source, hit.target);
+                        
+                        // the bullet is gone, so the serial pass picks up at the next one
+                        if(isDetectionStale())
+                        {
+                            collideBulletsFrom(lane, from, hit.source+1);
+                            isStale = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    // starts a detection round, the contacts found from here are checked against the shifts since
+    void resetShifts()
+    {
+        m_indexSlack += maxShift();
+        m_playerMaxShift = 0.0;
+        m_enemyMaxShift = 0.0;
+        m_playerShift.assign(m_players.size(), 0.0);
+        m_enemyShift.assign(m_enemies.size(), 0.0);
+    }
+    
+    double maxShift() const
+    {
+        return Max(m_playerMaxShift, m_enemyMaxShift);
+    }
+    
+    // a pair detected apart can only have closed by the pushes on both of its units
+    bool isDetectionStale() const
+    {
+        return KnockBackMargin < m_playerMaxShift + m_enemyMaxShift;
+    }
+    
+    // nockBack that also keeps count of how far the unit has been pushed
+    bool knockBack(Player& unit, double& shift, double& sideMaxShift, int32 damage)
+    {
+        const double x = unit.getPos().x;
+        const bool isKilled = unit.nockBack(damage);
+        shift += Abs(unit.getPos().x - x);
+        sideMaxShift = Max(sideMaxShift, shift);
+        return isKilled;
+    }
+    
+    bool isTouching(size_t p, size_t e)
+    {
+        Player& player = m_players[p];
+        Player& enemy = m_enemies[e];
+        return player.alive() && enemy.alive() && Circle(player.getPos(),30).intersects(Circle(enemy.getPos(),30));
+    }
+    
+    bool isShot(const BulletStore::Lane& lane, int32 from, size_t b, size_t i)
+    {
+        Player& target = (lane.isEnemyTeam[b] ? m_players : m_enemies)[i];
+        return lane.alive[b] && target.alive() && m_bullets.sweptHit(lane, b, from, target.getPos(), BulletHitRadius);
+    }
+    
+    void applyMelee(size_t p, size_t e)
+    {
+        Player& player = m_players[p];
+        Player& enemy = m_enemies[e];
+        
+        emit(SimEventType::Hit, Vec2((player.getPos().x+enemy.getPos().x)/2,player.getPos().y), 10, false);
+        
+        if(knockBack(player, m_playerShift[p], m_playerMaxShift, 5*enemy.getGrade()))
+        {
+            emit(SimEventType::Kill, player.getPos(), 10, false);
+            scoreRival(100);
+        }
+        if(knockBack(enemy, m_enemyShift[e], m_enemyMaxShift, 5*player.getGrade()))
+        {
+            emit(SimEventType::Kill, enemy.getPos(), 10, true);
+            m_score += 100;
+        }
+        else
+        {
+            emit(SimEventType::Damage, enemy.getPos(), 0, true);
+        }
+    }
+    
+    void applyBullet(BulletStore::Lane& lane, size_t b, size_t i)
+    {
+        const bool isEnemyTeam = lane.isEnemyTeam[b];
+        Player& target = (isEnemyTeam ? m_players : m_enemies)[i];
+        
+        const Vec2 pos = m_bullets.position(lane, b);
+        emit(SimEventType::Hit, Vec2((pos.x+target.getPos().x)/2,target.getPos().y), 6, false);
+        m_bullets.kill(lane, b);
+        
+        // a shot-down player has always burst in blue
+        if(knockBack(target, (isEnemyTeam ? m_playerShift : m_enemyShift)[i], isEnemyTeam ? m_playerMaxShift : m_enemyMaxShift, 2))
+        {
+            emit(SimEventType::Kill, target.getPos(), 10, true);
+            if(!isEnemyTeam)
+            {
+                m_score += 100;
+            }
+            else
+            {
+                scoreRival(100);
+            }
+        }
+        else
+        {
+            emit(SimEventType::Damage, target.getPos(), 0, !isEnemyTeam);
+        }
+    }
+    
+    // the rest of the melee pass one player at a time, from enemy e of player p on; the index is stale
+    // by at most the slack, and a player pushed past the margin looks around again
+    void collideMeleeFrom(size_t p, size_t e)
+    {
+        for (; p < m_players.size(); ++p, e = 0)
+        {
+            Player& player = m_players[p];
+            bool isMoved = true;
+            
+            while(isMoved && player.alive())
+            {
+                const double x = player.getPos().x;
+                const double reach = MeleeReach + KnockBackMargin + m_indexSlack + maxShift();
+                m_enemyIndex.query(x-reach, x+reach, m_serialCandidates);
+                isMoved = false;
+                
+                for(const auto i : m_serialCandidates)
+                {
+                    if(i < e)
+                    {
+                        continue;
+                    }
+                    e = i+1;
+                    
+                    if(isTouching(p, i))
+                    {
+                        applyMelee(p, i);
+                        if(KnockBackMargin < Abs(player.getPos().x - x))
+                        {
+                            isMoved = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    // the rest of one bullet lane one bullet at a time; a bullet stops at its first hit, so only the
+    // units it has already hit move while it is checked
+    void collideBulletsFrom(BulletStore::Lane& lane, int32 from, size_t b)
+    {
+        for (; b < lane.size(); ++b)
+        {
+            if(!lane.alive[b])
+            {
+                continue;
+            }
+            
+            const auto [x0, x1] = m_bullets.sweptRangeX(lane, b, from);
+            const double pad = BulletHitRadius + m_indexSlack + maxShift();
+            (lane.isEnemyTeam[b] ? m_playerIndex : m_enemyIndex).query(x0-pad, x1+pad, m_serialCandidates);
+            
+            for(const auto i : m_serialCandidates)
+            {
+                if(isShot(lane, from, b, i))
+                {
+                    applyBullet(lane, b, i);
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,94 @@
+# pragma once
+# include <Siv3D.hpp>
+
+// appends the match state to a byte buffer, every array goes in as its size and one block copy
+class SnapshotWriter
+{
+public:
+    // the buffer is cleared but keeps its capacity, so rewriting a snapshot of the same size does not allocate
+    explicit SnapshotWriter(Array<uint8>& bytes)
+    : m_bytes(bytes)
+    {
+        m_bytes.clear();
+    }
+    
+    void write(const void* data, size_t size)
+    {
+        const uint8* bytes = static_cast<const uint8*>(data);
+        m_bytes.insert(m_bytes.end(), bytes, bytes + size);
+    }
+    
+    template <class Type>
+    void write(const Type& value)
+    {
+        static_assert(std::is_trivially_copyable_v<Type>);
+        write(&value, sizeof(Type));
+    }
+    
+    template <class Type>
+    void write(const Array<Type>& values)
+    {
+        static_assert(std::is_trivially_copyable_v<Type>);
+        write(static_cast<uint64>(values.size()));
+        if(!values.isEmpty())
+        {
+            write(values.data(), values.size() * sizeof(Type));
+        }
+    }
+    
+private:
+    Array<uint8>& m_bytes;
+};
+
+// reads back what SnapshotWriter wrote in the same order, every read fails once the data runs out
+class SnapshotReader
+{
+public:
+    explicit SnapshotReader(const Array<uint8>& bytes)
+    : m_bytes(bytes)
+    {}
+    
+    bool read(void* data, size_t size)
+    {
+        if(m_bytes.size() - m_pos < size)
+        {
+            m_pos = m_bytes.size();
+            return false;
+        }
+        
+        std::memcpy(data, m_bytes.data() + m_pos, size);
+        m_pos += size;
+        return true;
+    }
+    
+    template <class Type>
+    bool read(Type& value)
+    {
+        static_assert(std::is_trivially_copyable_v<Type>);
+        return read(&value, sizeof(Type));
+    }
+    
+    template <class Type>
+    bool read(Array<Type>& values)
+    {
+        static_assert(std::is_trivially_copyable_v<Type>);
+        
+        uint64 size = 0;
+        if(!read(size) || (m_bytes.size() - m_pos) / sizeof(Type) < size)
+        {
+            return false;
+        }
+        
+        values.resize(static_cast<size_t>(size));
+        return values.isEmpty() || read(values.data(), values.size() * sizeof(Type));
+    }
+    
+    bool isEnd() const
+    {
+        return m_pos == m_bytes.size();
+    }
+    
+private:
+    const Array<uint8>& m_bytes;
+    size_t m_pos = 0;
+};
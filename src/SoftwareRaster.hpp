@@ -0,0 +1,169 @@
+# pragma once
+# include <Siv3D.hpp>
+# include "JobSystem.hpp"
+
+// a CPU stand-in for the GPU under RenderBatch: submitted triangles are queued and filled into an
+// Image by resolve(), split into row bands that run in parallel; every band walks the triangles in
+// submission order, so the picture does not depend on the thread count
+class SoftwareRaster
+{
+public:
+    explicit SoftwareRaster(const Size& size)
+    : m_image(size, Color(0, 0))
+    {}
+    
+    void setJobSystem(JobSystem* jobs)
+    {
+        m_jobs = jobs;
+    }
+    
+    void clear(const Color& color)
+    {
+        m_triangles.clear();
+        m_image.fill(color);
+    }
+    
+    // shapes are flat coloured, so the first vertex of a triangle gives its colour; glyph textures
+    // only exist on the GPU, textured quads are filled with their vertex colour at TextureAlpha
+    void drawTriangles(const Array<Vertex2D>& vertices, const Array<uint16>& indices, bool isTextured)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const Vertex2D& v0 = vertices[indices[i]];
+            ColorF color(v0.color.x, v0.color.y, v0.color.z, v0.color.w);
+            if(isTextured)
+            {
+                color.a *= TextureAlpha;
+            }
+            
+            m_triangles.push_back(Triangle{ { v0.pos, vertices[indices[i+1]].pos, vertices[indices[i+2]].pos }, color.toColor() });
+        }
+    }
+    
+    // fills everything queued since the last resolve
+    void resolve()
+    {
+        const size_t bands = (m_image.height() + BandHeight - 1) / BandHeight;
+        const auto fillBands = [this](size_t, size_t begin, size_t end)
+        {
+            for (size_t band = begin; band < end; ++band)
+            {
+                fillBand(static_cast<int32>(band*BandHeight), Min(static_cast<int32>((band+1)*BandHeight), m_image.height()));
+            }
+        };
+        
+        if(m_jobs)
+        {
+            m_jobs->parallelFor(bands, 1, fillBands);
+        }
+        else
+        {
+            fillBands(0, 0, bands);
+        }
+        
+        m_resolved += m_triangles.size();
+        m_triangles.clear();
+    }
+    
+    const Image& image() const
+    {
+        return m_image;
+    }
+    
+    // triangles filled since construction
+    size_t resolved() const
+    {
+        return m_resolved;
+    }
+    
+    // pixels whose channels differ from other's by more than tolerance; a size mismatch counts every pixel
+    size_t countDifferences(const Image& other, int32 tolerance = 2) const
+    {
+        if(other.size() != m_image.size())
+        {
+            return m_image.num_pixels();
+        }
+        
+        size_t count = 0;
+        for (int32 y = 0; y < m_image.height(); ++y)
+        {
+            for (int32 x = 0; x < m_image.width(); ++x)
+            {
+                const Color a = m_image[y][x], b = other[y][x];
+                if(tolerance < Abs(a.r - b.r) || tolerance < Abs(a.g - b.g) || tolerance < Abs(a.b - b.b) || tolerance < Abs(a.a - b.a))
+                {
+                    ++count;
+                }
+            }
+        }
+        return count;
+    }
+    
+private:
+    struct Triangle
+    {
+        Float2 p[3];
+        Color color;
+    };
+    
+    static constexpr int32 BandHeight = 16;
+    static constexpr float TextureAlpha = 0.5f;
+    
+    Image m_image;
+    Array<Triangle> m_triangles;
+    JobSystem* m_jobs = nullptr;
+    size_t m_resolved = 0;
+    
+    static float edge(const Float2& a, const Float2& b, float x, float y)
+    {
+        return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+    }
+    
+    // pixel centres inside the triangle, blended over what is there; rows [y0, y1) only
+    void fillBand(int32 y0, int32 y1)
+    {
+        for(const auto& triangle : m_triangles)
+        {
+            const Float2& a = triangle.p[0];
+            const Float2& b = triangle.p[1];
+            const Float2& c = triangle.p[2];
+            
+            const float area = edge(a, b, c.x, c.y);
+            if(area == 0.0f || triangle.color.a == 0)
+            {
+                continue;
+            }
+            const float sign = (area < 0.0f) ? -1.0f : 1.0f;
+            
+            const int32 left = Max(static_cast<int32>(std::floor(std::min({a.x, b.x, c.x}))), 0);
+            const int32 right = Min(static_cast<int32>(std::ceil(std::max({a.x, b.x, c.x}))), m_image.width());
+            const int32 top = Max(static_cast<int32>(std::floor(std::min({a.y, b.y, c.y}))), y0);
+            const int32 bottom = Min(static_cast<int32>(std::ceil(std::max({a.y, b.y, c.y}))), y1);
+            
+            const uint32 alpha = triangle.color.a;
+            const uint32 r = triangle.color.r * alpha, g = triangle.color.g * alpha, bl = triangle.color.b * alpha;
+            
+            for (int32 y = top; y < bottom; ++y)
+            {
+                Color* row = m_image[y];
+                const float py = y + 0.5f;
+                
+                for (int32 x = left; x < right; ++x)
+                {
+                    const float px = x + 0.5f;
+                    if(edge(a, b, px, py)*sign < 0.0f || edge(b, c, px, py)*sign < 0.0f || edge(c, a, px, py)*sign < 0.0f)
+                    {
+                        continue;
+                    }
+                    
+                    Color& dst = row[x];
+                    const uint32 inverse = 255 - alpha;
+                    dst.r = static_cast<uint8>((r + dst.r*inverse) / 255);
+                    dst.g = static_cast<uint8>((g + dst.g*inverse) / 255);
+                    dst.b = static_cast<uint8>((bl + dst.b*inverse) / 255);
+                    dst.a = static_cast<uint8>(alpha + dst.a*inverse / 255);
+                }
+            }
+        }
+    }
+};